@@ -0,0 +1,1574 @@
+/* $begin tinymain */
+/*
+ * tiny.c - A simple, iterative HTTP/1.0 Web server that uses the
+ *     GET method to serve static and dynamic content.
+ *
+ * Updated 11/2019 droh
+ *   - Fixed sprintf() aliasing issue in serve_static(), and clienterror().
+ */
+#include <signal.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/pidfd.h>
+#include <spawn.h>
+#include <dlfcn.h>
+#include <zlib.h>
+#include "csapp.h"
+#include "sbuf.h"
+#include "handler.h"
+#include "diskio.h"
+
+#define SBUFSIZE 64        // 처리를 기다리는 연결 대기열 크기 (worker 스레드를 사용하는 경우)
+#define KEEPALIVE_TIMEOUT 5 // keep-alive 연결에서 다음 요청을 기다리는 기본 시간(초)
+#define KEEPALIVE_MAX 100   // keep-alive 연결 하나에서 처리할 기본 최대 요청 수
+#define CGI_WORKERS_MAX 64 // 띄워둘 수 있는 CGI worker 최대 개수
+#define HANDLERS_MAX 32    // 기억해 둘 CGI 프로그램의 플러그인 핸들러 최대 개수
+#define FILE_CACHE_SIZE 32 // 열어둘 파일 최대 개수
+#define FILE_CACHE_TTL 1   // inotify를 사용할 수 없을 때 stat 결과를 다시 확인하는 주기(초)
+#define STATIC_CACHE_SIZE 8388608 // 메모리에 보관할 정적 파일 바디의 총 크기
+#define STATIC_OBJECT_SIZE 524288 // 메모리에 보관할 정적 파일 하나의 최대 크기
+#define GZIP_CACHE_SIZE 4194304  // 메모리에 보관할 gzip 압축 바디의 총 크기
+#define RANGES_MAX 16      // 한 Range 요청에서 처리할 최대 구간 수 (더 많으면 파일 전체를 전송)
+#define RANGE_BOUNDARY "TINY_BYTERANGES_3d6b1f" // multipart/byteranges 파트 경계
+
+/* serve_static에서 사용하는 요청 헤더 값 (요청에 없으면 빈 문자열) */
+typedef struct
+{
+    char range[MAXLINE];             // Range
+    char accept_encoding[MAXLINE];   // Accept-Encoding
+    char if_none_match[MAXLINE];     // If-None-Match
+    char if_modified_since[MAXLINE]; // If-Modified-Since
+    char connection[MAXLINE];        // Connection
+    int keep_alive;                  // 응답 후 연결을 유지하면 1
+} request_hdrs_t;
+
+/* 파일 캐시 엔트리: 요청마다 stat, open, close를 하지 않도록 열린 fd와 stat 결과를 보관 */
+typedef struct
+{
+    char filename[MAXLINE];
+    int fd;                  // 읽기용으로 열어둔 fd (읽을 수 없는 파일이면 -1)
+    struct stat sbuf;        // 파일을 열 때의 stat 결과
+    int wd;                  // inotify watch descriptor (감시하지 않으면 -1)
+    time_t loaded;           // stat한 시각
+    unsigned long last_used; // 마지막으로 사용한 순서 (LRU 교체에 사용)
+    int refcnt;              // 현재 이 엔트리를 사용 중인 요청 수
+    int stale;               // 파일이 바뀌어 더 이상 찾을 수 없는 엔트리면 1
+    char *header;            // 미리 만들어 둔 정적 응답 헤더 (아직 전송하지 않았으면 NULL)
+    int header_len;
+    char *body;              // 메모리에 보관한 파일 내용 (큰 파일이면 NULL)
+    int loading;             // 다른 요청이 file_mutex 밖에서 바디를 읽는 중이면 1
+    int gzip;                // gzip 응답 준비 상태 (GZIP_UNKNOWN, GZIP_LOADING, GZIP_NONE, GZIP_SIDECAR, GZIP_MEMORY)
+    char *gz_header;         // GZIP_MEMORY: gzip 응답 헤더와 압축한 바디
+    int gz_header_len;
+    char *gz_body;
+    long gz_len;
+} file_entry_t;
+
+/* file_entry_t의 gzip 응답 준비 상태 */
+#define GZIP_UNKNOWN 0 // 아직 gzip으로 요청되지 않음
+#define GZIP_NONE 1    // gzip으로 보내지 않음 (압축하지 않는 타입이거나 압축할 수 없음)
+#define GZIP_SIDECAR 2 // 미리 압축해 둔 `파일.gz`를 전송
+#define GZIP_MEMORY 3  // 메모리에 압축해 둔 바디를 전송
+#define GZIP_LOADING 4 // 다른 요청이 file_mutex 밖에서 sidecar를 찾거나 압축하는 중 (그동안은 원본 그대로 전송)
+
+static file_entry_t file_cache[FILE_CACHE_SIZE];
+static unsigned long file_clock; // 엔트리를 사용할 때마다 증가
+static int inotify_fd = -1;      // 캐싱한 파일의 변경을 감시하는 inotify 인스턴스
+/* persistent CGI worker: CGI 프로그램을 한 번 실행해 두고 소켓으로 요청을 반복해서 전달 */
+typedef struct
+{
+    char filename[MAXLINE]; // 실행 중인 CGI 프로그램
+    pid_t pid;              // 0이면 빈 슬롯, -1이면 persistent 모드를 지원하지 않는 프로그램
+    int fd;                 // worker의 표준 입출력과 연결된 소켓
+    time_t mtime;           // 실행할 때의 프로그램 수정 시각 (바뀌면 다시 실행)
+    ino_t ino;
+    int busy;               // 요청을 처리 중이면 1
+    rio_t rio;              // worker 응답을 읽는 버퍼
+} cgi_worker_t;
+
+/* 플러그인 핸들러: CGI 프로그램 대신 dlopen한 공유 라이브러리의 함수를 호출 */
+typedef struct
+{
+    char filename[MAXLINE]; // CGI 프로그램 (플러그인은 `filename.so`)
+    void *dl;               // dlopen 핸들 (플러그인이 없으면 NULL)
+    cgi_handler_t handler;  // 플러그인의 핸들러 함수 (없으면 NULL)
+} handler_entry_t;
+
+static long static_cache_used;   // 메모리에 보관 중인 정적 파일 바디의 총 크기
+static int keepalive_timeout = -1;                // keep-alive 유휴 시간(초) (0이면 요청마다 연결을 닫음, -k가 없으면 main에서 결정)
+static int keepalive_max = KEEPALIVE_MAX;         // keep-alive 연결 하나에서 처리할 최대 요청 수
+static int static_max_age = -1;  // 정적 응답의 Cache-Control max-age (음수면 Cache-Control을 보내지 않음)
+static long gzip_cache_used;     // 메모리에 보관 중인 gzip 압축 바디의 총 크기
+static sem_t file_mutex;         // 파일 캐시를 보호하는 세마포어
+static sbuf_t conn_sbuf;         // worker 스레드에 전달할 연결 대기열
+static cgi_worker_t cgi_workers[CGI_WORKERS_MAX];
+static int cgi_worker_cnt;       // 띄워둘 CGI worker 최대 개수 (0이면 요청마다 fork/exec)
+static sem_t cgi_mutex;          // CGI worker 슬롯을 보호하는 세마포어
+static int reap_epfd = -1;       // 종료를 기다리는 CGI 자식 프로세스의 pidfd를 감시하는 epoll
+static handler_entry_t handlers[HANDLERS_MAX];
+static int handler_cnt;          // handlers에 기억해 둔 CGI 프로그램 수
+static sem_t handler_mutex;      // 플러그인 핸들러 목록을 보호하는 세마포어
+
+void *thread(void *vargp);
+int open_reuseport_listenfd(char *port);
+
+void doit(int fd);
+int serve_request(int fd, rio_t *rio, int can_keep);
+int is_keep_alive(char *version, char *connection);
+int has_token(char *list, char *token);
+char *connection_hdr(request_hdrs_t *hdrs);
+int read_requesthdrs(rio_t *rp, request_hdrs_t *hdrs);
+void hdr_value(char *line, ssize_t n, int name_len, char *value);
+int parse_uri(char *uri, char *filename, char *cgiargs);
+int serve_static(int fd, file_entry_t *file, char *method, request_hdrs_t *hdrs);
+int load_static(file_entry_t *file);
+void load_body(file_entry_t *file);
+void get_filetype(char *filename, char *filetype);
+long send_file(int fd, int srcfd, long start, long length);
+int send_body(int fd, file_entry_t *file, long offset, long length);
+int build_static_header(file_entry_t *file, char *buf, char *status, char *filetype, long length, char *extra, int gzip);
+int serve_gzip(int fd, file_entry_t *file, char *method, request_hdrs_t *hdrs);
+int load_gzip(file_entry_t *file);
+int accepts_gzip(char *accept);
+int is_compressible(char *filetype);
+int static_cache_headers(file_entry_t *file, char *buf, char *filetype, int gzip);
+void static_etag(file_entry_t *file, int gzip, char *etag);
+int serve_not_modified(int fd, file_entry_t *file, request_hdrs_t *hdrs);
+int match_etag(file_entry_t *file, char *if_none_match, int gzip_ok);
+time_t parse_http_date(char *date);
+int serve_range(int fd, file_entry_t *file, char *method, request_hdrs_t *hdrs);
+int parse_range(char *range, long filesize, long ranges[][2]);
+int range_part_header(char *buf, char *filetype, long range[2], long filesize);
+void set_cork(int fd, int on);
+void init_file_cache(void);
+file_entry_t *open_file(char *filename);
+void release_file(file_entry_t *entry);
+void drain_file_events(void);
+void invalidate_file(file_entry_t *entry);
+void free_file(file_entry_t *entry);
+void serve_dynamic(int fd, char *filename, char *cgiargs, char *method);
+pid_t spawn_cgi(char *filename, int in_fd, int out_fd, char **cgi_env);
+void watch_child(pid_t pid);
+void *reaper(void *vargp);
+void init_cgi(void);
+int serve_cgi_worker(int fd, char *filename, struct stat *sbuf, char *cgiargs, char *method);
+cgi_worker_t *acquire_cgi_worker(char *filename, struct stat *sbuf);
+void release_cgi_worker(cgi_worker_t *worker);
+void stop_cgi_worker(cgi_worker_t *worker, int unsupported);
+void clear_cgi_worker(cgi_worker_t *worker);
+cgi_handler_t lookup_handler(char *filename);
+int serve_handler(int fd, char *filename, char *cgiargs, char *method);
+void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);
+
+int main(int argc, char **argv)
+{
+    int listenfd, connfd, opt, nthreads = 0, nprocs = 1, disk_threads = DISK_THREADS;
+    char hostname[MAXLINE], port[MAXLINE];
+    socklen_t clientlen;
+    struct sockaddr_storage clientaddr;
+    pthread_t tid;
+
+    /* Check command line args */
+    // -t threads: 연결을 처리할 worker 스레드 수 (0이면 accept 루프에서 하나씩 처리)
+    // -p procs: SO_REUSEPORT로 같은 포트를 나눠 받을 프로세스 수 (커널이 연결을 프로세스에 분배)
+    // -c workers: 요청마다 fork/exec 하지 않고 띄워둘 persistent CGI worker 수 (0이면 사용 안 함)
+    // -m max_age: 정적 응답에 붙일 Cache-Control의 max-age (지정하지 않으면 Cache-Control을 보내지 않음)
+    // -k timeout: keep-alive 연결에서 다음 요청을 기다리는 시간(초) (0이면 요청마다 연결을 닫음), -n requests: 연결당 최대 요청 수
+    // (keep-alive 연결은 유휴 시간 동안 스레드를 차지하므로 -t로 worker 스레드를 충분히 띄워서 사용)
+    // (-t 없이 accept 루프에서 하나씩 처리하면 유휴 연결 하나가 서버 전체를 멈추므로, -k를 지정하지 않으면 keep-alive를 사용하지 않음)
+    // -d threads: 큰 파일을 전송하기 전에 다음 구간을 페이지 캐시로 미리 읽어둘 디스크 스레드 수 (0이면 사용 안 함)
+    while ((opt = getopt(argc, argv, "t:p:c:m:k:n:d:")) != -1)
+    {
+        if (opt == 't')
+            nthreads = atoi(optarg);
+        else if (opt == 'p')
+            nprocs = atoi(optarg);
+        else if (opt == 'c')
+            cgi_worker_cnt = atoi(optarg);
+        else if (opt == 'm')
+            static_max_age = atoi(optarg);
+        else if (opt == 'k')
+        {
+            if ((keepalive_timeout = atoi(optarg)) < 0)
+                nprocs = 0; // 잘못된 값이면 usage 출력
+        }
+        else if (opt == 'n')
+            keepalive_max = atoi(optarg);
+        else if (opt == 'd')
+            disk_threads = atoi(optarg);
+        else
+            nprocs = 0;
+    }
+    if (argc - optind != 1 || nthreads < 0 || nprocs < 1 || cgi_worker_cnt < 0 || cgi_worker_cnt > CGI_WORKERS_MAX ||
+        keepalive_max < 1 || disk_threads < 0)
+    {
+        fprintf(stderr, "usage: %s [-t threads] [-p procs] [-c cgi_workers] [-m max_age] [-k keepalive_timeout] [-n keepalive_requests] [-d disk_threads] <port>\n", argv[0]);
+        exit(1);
+    }
+
+    if (keepalive_timeout < 0)
+        keepalive_timeout = nthreads > 0 ? KEEPALIVE_TIMEOUT : 0;
+
+    for (int i = 1; i < nprocs; i++) // 부모를 포함해 nprocs개의 프로세스가 각자 수신 소켓을 연다
+        if (Fork() == 0)
+            break;
+
+    init_file_cache();
+    init_cgi();
+    init_diskio(disk_threads);
+    if (nprocs > 1)
+        listenfd = open_reuseport_listenfd(argv[optind]);
+    else
+        listenfd = Open_listenfd(argv[optind]); // 전달받은 포트 번호를 사용해 수신 소켓 생성
+    if (listenfd < 0)
+        unix_error("open_reuseport_listenfd error");
+    fcntl(listenfd, F_SETFD, FD_CLOEXEC); // CGI 프로그램(특히 오래 사는 persistent worker)이 수신 소켓을 물려받지 않도록
+
+    if (nthreads > 0)
+    { // Prethreaded 서버: 미리 만든 worker 스레드가 대기열의 연결을 처리
+        sbuf_init(&conn_sbuf, SBUFSIZE);
+        for (int i = 0; i < nthreads; i++)
+            Pthread_create(&tid, NULL, thread, NULL);
+    }
+
+    while (1)
+    {
+        clientlen = sizeof(clientaddr);
+        connfd = Accept(listenfd, (SA *)&clientaddr, &clientlen);                       // line:netp:tiny:accept 클라이언트 연결 요청 수신
+        fcntl(connfd, F_SETFD, FD_CLOEXEC);                                             // CGI 프로그램이 다른 연결의 소켓을 물려받으면 tiny가 닫아도 FIN이 가지 않음
+        Getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE, 0); // 클라이언트의 호스트 이름과 포트 번호 파악
+        printf("Accepted connection from (%s, %s)\n", hostname, port);
+        if (nthreads > 0)
+        {
+            sbuf_insert(&conn_sbuf, connfd); // worker 스레드에 전달
+            continue;
+        }
+        doit(connfd);  // line:netp:tiny:doit 클라이언트의 요청 처리
+        Close(connfd); // line:netp:tiny:close 연결 종료
+    }
+}
+
+void *thread(void *vargp)
+{
+    Pthread_detach(pthread_self());
+    while (1)
+    {
+        int connfd = sbuf_remove(&conn_sbuf);
+        doit(connfd);
+        Close(connfd);
+    }
+    return NULL;
+}
+
+// SO_REUSEPORT를 설정한 수신 소켓을 여는 함수 (open_listenfd와 같은 반환 값)
+// 여러 프로세스가 같은 포트에 각자 소켓을 열면 커널이 새 연결을 나눠준다.
+int open_reuseport_listenfd(char *port)
+{
+    struct addrinfo hints, *listp, *p;
+    int listenfd, rc, optval = 1;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG | AI_NUMERICSERV;
+    if ((rc = getaddrinfo(NULL, port, &hints, &listp)) != 0)
+    {
+        fprintf(stderr, "getaddrinfo failed (port %s): %s\n", port, gai_strerror(rc));
+        return -2;
+    }
+
+    for (p = listp; p; p = p->ai_next)
+    {
+        if ((listenfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+            continue;
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int));
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(int));
+        if (bind(listenfd, p->ai_addr, p->ai_addrlen) == 0)
+            break;
+        Close(listenfd);
+    }
+
+    freeaddrinfo(listp);
+    if (!p || listen(listenfd, LISTENQ) < 0)
+        return -1;
+    return listenfd;
+}
+
+// 클라이언트 연결 하나를 처리하는 함수
+// keep-alive 연결이면 클라이언트가 연결을 닫거나, 유휴 시간이 지나거나, 최대 요청 수를 처리할 때까지 요청을 차례로 처리
+// (파이프라이닝으로 한 번에 도착한 요청들은 rio 버퍼에 남아 있다가 이어서 처리됨)
+void doit(int fd)
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    rio_t rio; // 버퍼 (연결의 모든 요청이 함께 사용)
+    struct timeval timeout = {keepalive_timeout, 0};
+    int served = 0;
+
+    Rio_readinitb(&rio, fd); // 버퍼(rio)를 초기화하고, rio와 파일 디스크립터(fd)를 연결한다.
+    if (keepalive_timeout > 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); // 다음 요청을 기다리는 최대 시간
+    while (serve_request(fd, &rio, keepalive_timeout > 0 && ++served < keepalive_max))
+        ;
+}
+
+// 요청 하나를 읽어서 응답하는 함수 (can_keep: 응답 후 연결을 유지할 수 있으면 1)
+// 응답 후 같은 연결에서 다음 요청을 기다려야 하면 1, 연결을 닫아야 하면 0을 리턴
+int serve_request(int fd, rio_t *rio, int can_keep)
+{
+    int is_static;
+    struct stat sbuf;
+    file_entry_t *file;
+    char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE]; // MAXLINE: 8192
+    char filename[MAXLINE], cgiargs[MAXLINE];
+    request_hdrs_t hdrs;
+
+    /* 요청 라인과 헤더 읽기 */
+    if (rio_readlineb(rio, buf, MAXLINE) <= 0) // 버퍼(rio)에서 한 줄 읽기 (클라이언트가 연결을 닫았거나 유휴 시간이 지나면 종료)
+        return 0;
+    printf("Request headers:\n");
+    printf("%s", buf);
+    if (sscanf(buf, "%s %s %s", method, uri, version) != 3) // buf 문자열에서 method, uri, version을 읽어온다.
+    {
+        clienterror(fd, buf, "400", "Bad request", "Tiny couldn't parse the request line");
+        return 0;
+    }
+    if (strcasecmp(method, "GET"))
+    { // 요청 메소드가 GET이 아니면 에러 처리
+        clienterror(fd, method, "501", "Not implemented", "Tiny does not implement this method");
+        return 0;
+    }
+    if (read_requesthdrs(rio, &hdrs) < 0) // 요청 헤더를 읽고 파싱한다.(요청 헤더를 읽어서 클라이언트가 요청한 추가 정보를 처리한다.)
+        return 0;
+    hdrs.keep_alive = can_keep && is_keep_alive(version, hdrs.connection);
+
+    /* URI 파싱 */
+    is_static = parse_uri(uri, filename, cgiargs); // 요청이 정적 콘텐츠인지 동적 콘텐츠인지 파악한다.
+    if (!(file = open_file(filename)))
+    { // 파일이 디스크에 없으면 에러 처리
+        clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
+        return 0;
+    }
+    sbuf = file->sbuf; // 파일 캐시에 있던 stat 결과 (캐시에 없었으면 방금 stat한 결과)
+
+    if (is_static)
+    { // 정적 컨텐츠인 경우
+        if (!(S_ISREG(sbuf.st_mode)) || !(S_IRUSR & sbuf.st_mode) || file->fd < 0)
+        { // 일반 파일이 아니거나 읽기 권한이 없는 경우 에러 처리
+            clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't read the file");
+            release_file(file);
+            return 0;
+        }
+        if (serve_static(fd, file, method, &hdrs) < 0) // 정적 컨텐츠 제공 (전송 중에 클라이언트가 연결을 끊으면 이 연결만 닫음)
+            hdrs.keep_alive = 0;
+    }
+    else
+    { // 동적 컨텐츠인 경우 (CGI 응답은 길이를 알 수 없으므로 응답 후 연결을 닫음)
+        hdrs.keep_alive = 0;
+        if (!(S_ISREG(sbuf.st_mode)) || !(S_IXUSR & sbuf.st_mode))
+        { // 일반 파일이 아니거나 실행 권한이 없는 경우 에러 처리
+            clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't run the CGI program");
+            release_file(file);
+            return 0;
+        }
+        // 플러그인 핸들러 -> persistent CGI worker -> CGI 프로그램 실행 순서로 시도
+        if (!serve_handler(fd, filename, cgiargs, method) &&
+            (!cgi_worker_cnt || !serve_cgi_worker(fd, filename, &sbuf, cgiargs, method)))
+            serve_dynamic(fd, filename, cgiargs, method); // 동적 컨텐츠 제공
+    }
+    release_file(file);
+    return hdrs.keep_alive;
+}
+
+// 요청의 HTTP 버전과 Connection 헤더로 응답 후 연결을 유지할지 결정하는 함수
+// HTTP/1.1은 `Connection: close`가 없으면, HTTP/1.0은 `Connection: keep-alive`가 있으면 유지
+int is_keep_alive(char *version, char *connection)
+{
+    if (!strcasecmp(version, "HTTP/1.1"))
+        return !has_token(connection, "close");
+    return has_token(connection, "keep-alive");
+}
+
+// 쉼표로 구분된 헤더 값(list)에 token이 있는지 확인하는 함수 (대소문자 구분 없음)
+int has_token(char *list, char *token)
+{
+    int n, len = strlen(token);
+
+    for (char *p = list; *p; p += strcspn(p, ","))
+    {
+        while (*p == ',' || *p == ' ')
+            p++;
+        for (n = strcspn(p, ","); n > 0 && p[n - 1] == ' '; n--)
+            ;
+        if (n == len && !strncasecmp(p, token, len))
+            return 1;
+    }
+    return 0;
+}
+
+// 응답 헤더의 마지막 줄: 연결 유지 여부와 헤더를 끝내는 빈 줄
+char *connection_hdr(request_hdrs_t *hdrs)
+{
+    return hdrs->keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+}
+
+// 클라이언트에 에러를 전송하는 함수(cause: 오류 원인, errnum: 오류 번호, shortmsg: 짧은 오류 메시지, longmsg: 긴 오류 메시지)
+void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg)
+{
+    char buf[MAXLINE], body[MAXBUF]; // buf: HTTP 응답 헤더, body: HTML 응답의 본문인 문자열(오류 메시지와 함께 HTML 형태로 클라이언트에게 보여짐)
+
+    /* 응답 본문 생성 */
+    sprintf(body, "<html><title>Tiny Error</title>");
+    sprintf(body, "%s<body bgcolor="
+                  "ffffff"
+                  ">\r\n",
+            body);
+    sprintf(body, "%s%s: %s\r\n", body, errnum, shortmsg);
+    sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
+    sprintf(body, "%s<hr><em>The Tiny Web server</em>\r\n", body);
+
+    /* 응답 출력 (에러 응답 후에는 연결을 닫으므로 전송 실패는 무시) */
+    sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
+    rio_writen(fd, buf, strlen(buf)); // 클라이언트에 전송 '버전 에러코드 에러메시지'
+    sprintf(buf, "Content-type: text/html\r\n");
+    rio_writen(fd, buf, strlen(buf));                              // 컨텐츠 타입
+    sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body)); // \r\n: 헤더와 바디를 나누는 개행
+    rio_writen(fd, buf, strlen(buf));                              // 컨텐츠 크기
+    rio_writen(fd, body, strlen(body));                            // 응답 본문(HTML 형식)
+}
+
+// 요청 헤더를 읽고 serve_static에서 사용할 헤더 값을 hdrs에 저장하는 함수 (헤더가 끝나기 전에 연결이 끊어지면 -1)
+int read_requesthdrs(rio_t *rp, request_hdrs_t *hdrs)
+{
+    char *line; // rio 내부 버퍼 안의 헤더 줄 (복사하지 않음)
+    ssize_t n;
+
+    hdrs->range[0] = hdrs->accept_encoding[0] = hdrs->if_none_match[0] = hdrs->if_modified_since[0] = '\0';
+    hdrs->connection[0] = '\0';
+    while ((n = rio_readlinep(rp, &line)) > 0) // 요청 메시지의 헤더를 한 줄씩 읽기
+    {
+        printf("%.*s", (int)n, line);                                           // 헤더 필드 출력
+        if ((n == 2 && !strncmp(line, "\r\n", 2)) || (n == 1 && line[0] == '\n')) // 빈 줄이면 헤더의 끝
+            return 0;
+        if (n > 6 && !strncasecmp(line, "Range:", 6))
+            hdr_value(line, n, 6, hdrs->range);
+        else if (n > 16 && !strncasecmp(line, "Accept-Encoding:", 16))
+            hdr_value(line, n, 16, hdrs->accept_encoding);
+        else if (n > 14 && !strncasecmp(line, "If-None-Match:", 14))
+            hdr_value(line, n, 14, hdrs->if_none_match);
+        else if (n > 18 && !strncasecmp(line, "If-Modified-Since:", 18))
+            hdr_value(line, n, 18, hdrs->if_modified_since);
+        else if (n > 11 && !strncasecmp(line, "Connection:", 11))
+            hdr_value(line, n, 11, hdrs->connection);
+    }
+    return -1;
+}
+
+// 헤더 줄(line, 길이 n)에서 `이름:`(name_len) 뒤의 값을 앞뒤 공백과 CRLF를 빼고 value에 복사하는 함수
+void hdr_value(char *line, ssize_t n, int name_len, char *value)
+{
+    char *start = line + name_len, *end = line + n;
+
+    while (start < end && isspace((unsigned char)*start))
+        start++;
+    while (end > start && isspace((unsigned char)end[-1]))
+        end--;
+    snprintf(value, MAXLINE, "%.*s", (int)(end - start), start);
+}
+
+// URI에서 요청된 파일 이름과 CGI 인자 추출
+int parse_uri(char *uri, char *filename, char *cgiargs)
+{
+    char *ptr;
+
+    if (!strstr(uri, "cgi-bin"))
+    { // uri에 cgi-bin이 없으면 정적 컨텐츠
+        strcpy(cgiargs, "");
+        strcpy(filename, ".");             // filename에 현재 디렉터리를 넣고
+        strcat(filename, uri);             // filename에 uri를 이어 붙인다.
+        if (uri[strlen(uri) - 1] == '/')   // uri가 /로 끝나면
+            strcat(filename, "home.html"); //  filename에 home.html를 이어 붙인다.
+        return 1;                          // 정적 컨텐츠일 때는 1 리턴
+    }
+    else
+    { // 동적 컨텐츠
+        ptr = index(uri, '?');
+        if (ptr)
+        {
+            strcpy(cgiargs, ptr + 1);
+            *ptr = '\0';
+        }
+        else
+            strcpy(cgiargs, "");
+        strcpy(filename, ".");
+        strcat(filename, uri);
+        return 0;
+    }
+}
+
+// file: 파일 캐시 엔트리 (파일 캐시가 열어둔 fd를 사용하고 닫지 않음)
+// 응답을 모두 보냈으면 0, 전송 중에 클라이언트가 연결을 끊었으면 -1을 리턴
+// (클라이언트 소켓에는 Rio_ 래퍼 대신 rio_ 함수를 사용해서, 연결 하나의 EPIPE/ECONNRESET이 서버 전체를 종료하지 않음)
+int serve_static(int fd, file_entry_t *file, char *method, request_hdrs_t *hdrs)
+{
+    int filesize = file->sbuf.st_size, rc;
+    char *conn = connection_hdr(hdrs); // 헤더의 마지막 줄 (캐시한 헤더에는 연결 방식이 없음)
+    struct iovec iov[3];
+
+    /* 응답 헤더 준비 */
+    P(&file_mutex);
+    int load = !file->header && load_static(file); // 처음 전송하는 파일이면 헤더를 만들어 두고, 작은 파일은 바디도 메모리에 보관
+    V(&file_mutex);
+    if (load) // 디스크 읽기를 기다리는 동안 다른 요청이 파일 캐시를 사용할 수 있도록 잠금 밖에서 읽음
+        load_body(file);
+
+    /* 클라이언트가 가진 파일이 최신이면 바디 없이 304 응답 */
+    if ((rc = serve_not_modified(fd, file, hdrs)))
+        return rc < 0 ? -1 : 0;
+    /* Range 요청이면 요청한 구간만 전송 (Range 헤더를 사용할 수 없으면 파일 전체를 전송) */
+    if (hdrs->range[0] && (rc = serve_range(fd, file, method, hdrs)))
+        return rc < 0 ? -1 : 0;
+    /* 클라이언트가 gzip을 허용하면 압축한 응답 전송 (Range 요청은 원본 그대로의 구간을 전송) */
+    if (!hdrs->range[0] && accepts_gzip(hdrs->accept_encoding) && (rc = serve_gzip(fd, file, method, hdrs)))
+        return rc < 0 ? -1 : 0;
+    printf("Response headers:\n");
+    printf("%s%s", file->header, conn);
+
+    /* 메모리에 있는 파일은 헤더와 바디를 한 번의 writev로 전송 */
+    iov[0].iov_base = file->header;
+    iov[0].iov_len = file->header_len;
+    iov[1].iov_base = conn;
+    iov[1].iov_len = strlen(conn);
+    if (strcasecmp(method, "HEAD") == 0 || filesize == 0)
+    { // HTTP HEAD 메소드 처리
+        return rio_writev(fd, iov, 2) < 0 ? -1 : 0; // 응답 바디를 전송하지 않음
+    }
+    if (file->body)
+    {
+        iov[2].iov_base = file->body;
+        iov[2].iov_len = filesize;
+        return rio_writev(fd, iov, 3) < 0 ? -1 : 0;
+    }
+
+    /* 응답 바디 전송 */
+    set_cork(fd, 1); // 헤더와 바디의 앞부분을 한 세그먼트로 모아서 전송
+    rc = rio_writev(fd, iov, 2) < 0 ? -1 : send_body(fd, file, 0, filesize); // 헤더 정보 전송 후 바디 전송
+    set_cork(fd, 0); // 모아둔 나머지 데이터 전송
+    return rc;
+}
+
+// 조건부 요청(If-None-Match, If-Modified-Since)의 validator가 현재 파일과 같으면 바디 없이 304 Not Modified로 응답하는 함수
+// 304로 응답했으면 1, 아니면 0, 전송에 실패했으면 -1을 리턴 (If-None-Match가 있으면 If-Modified-Since는 무시)
+int serve_not_modified(int fd, file_entry_t *file, request_hdrs_t *hdrs)
+{
+    char buf[MAXBUF], filetype[MAXLINE];
+    int n, gzip;
+    time_t since;
+
+    get_filetype(file->filename, filetype);
+    gzip = is_compressible(filetype) && accepts_gzip(hdrs->accept_encoding); // gzip 응답의 ETag도 비교
+    if (hdrs->if_none_match[0])
+    {
+        if ((gzip = match_etag(file, hdrs->if_none_match, gzip)) < 0)
+            return 0;
+    }
+    else if (hdrs->if_modified_since[0])
+    {
+        if ((since = parse_http_date(hdrs->if_modified_since)) < 0 || file->sbuf.st_mtime > since)
+            return 0;
+        gzip = gzip && (file->gzip == GZIP_MEMORY || file->gzip == GZIP_SIDECAR);
+    }
+    else
+        return 0;
+
+    n = sprintf(buf, "HTTP/1.1 304 Not Modified\r\n");
+    n += sprintf(buf + n, "Server: Tiny Web Server\r\n");
+    n += static_cache_headers(file, buf + n, filetype, gzip);
+    n += sprintf(buf + n, "%s", connection_hdr(hdrs));
+    printf("Response headers:\n");
+    printf("%s", buf);
+    return rio_writen(fd, buf, n) != n ? -1 : 1;
+}
+
+// HTTP 날짜(`Sun, 06 Nov 1994 08:49:37 GMT`)를 time_t로 바꾸는 함수 (형식이 다르면 -1)
+time_t parse_http_date(char *date)
+{
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4], *p;
+    struct tm tm;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(date, "%*3s, %d %3s %d %d:%d:%d GMT", &tm.tm_mday, month, &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6 ||
+        strlen(month) != 3 || !(p = strstr(months, month)) || (p - months) % 3)
+        return -1;
+    tm.tm_mon = (p - months) / 3;
+    tm.tm_year -= 1900;
+    return timegm(&tm);
+}
+
+// If-None-Match의 ETag 목록에 파일의 ETag가 있는지 확인하는 함수 (`W/` 약한 ETag도 같은 것으로 비교)
+// 원본의 ETag와 같으면 0, gzip 응답의 ETag와 같으면 1(gzip_ok일 때만 비교), 없으면 -1을 리턴
+int match_etag(file_entry_t *file, char *if_none_match, int gzip_ok)
+{
+    char etag[2][64], *p = if_none_match;
+    int i, len;
+
+    static_etag(file, 0, etag[0]);
+    static_etag(file, 1, etag[1]);
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (*p == '*') // 어떤 ETag와도 일치
+            return 0;
+        if (!strncmp(p, "W/", 2))
+            p += 2;
+        for (len = strcspn(p, ","); len > 0 && p[len - 1] == ' '; len--)
+            ;
+        for (i = 0; i <= gzip_ok; i++)
+            if (len == strlen(etag[i]) && !strncmp(p, etag[i], len))
+                return i;
+        p += strcspn(p, ",");
+    }
+    return -1;
+}
+
+// Range 요청에 206 Partial Content로 응답하는 함수 (구간이 여러 개면 multipart/byteranges로 전송)
+// Range 헤더를 사용할 수 없으면(형식 오류, 너무 많은 구간) 아무것도 보내지 않고 0을 리턴 (파일 전체를 전송)
+// 응답했으면 1, 전송 중에 클라이언트가 연결을 끊었으면 -1 (미디어 플레이어가 탐색하면서 흔히 끊음)
+int serve_range(int fd, file_entry_t *file, char *method, request_hdrs_t *hdrs)
+{
+    char buf[MAXBUF], filetype[MAXLINE], content_range[MAXLINE], part[MAXLINE];
+    long ranges[RANGES_MAX][2], filesize = file->sbuf.st_size, length = 0;
+    int i, n, cnt;
+
+    if ((cnt = parse_range(hdrs->range, filesize, ranges)) == 0)
+        return 0;
+    if (cnt < 0)
+    { // 요청한 구간이 모두 파일 밖인 경우
+        n = sprintf(buf, "HTTP/1.1 416 Range Not Satisfiable\r\n");
+        n += sprintf(buf + n, "Server: Tiny Web Server\r\n");
+        n += sprintf(buf + n, "Content-Range: bytes */%ld\r\n", filesize);
+        n += sprintf(buf + n, "Content-length: 0\r\n");
+        n += sprintf(buf + n, "%s", connection_hdr(hdrs));
+        return rio_writen(fd, buf, n) != n ? -1 : 1;
+    }
+
+    /* 응답 헤더 생성 */
+    get_filetype(file->filename, filetype);
+    if (cnt == 1)
+    {
+        length = ranges[0][1] - ranges[0][0] + 1;
+        sprintf(content_range, "Content-Range: bytes %ld-%ld/%ld\r\n", ranges[0][0], ranges[0][1], filesize);
+        n = build_static_header(file, buf, "206 Partial Content", filetype, length, content_range, 0);
+    }
+    else
+    { // 바디 길이: 각 구간의 파트 헤더와 데이터, 마지막 경계
+        for (i = 0; i < cnt; i++)
+            length += range_part_header(part, filetype, ranges[i], filesize) + ranges[i][1] - ranges[i][0] + 1;
+        length += strlen("\r\n--" RANGE_BOUNDARY "--\r\n");
+        n = build_static_header(file, buf, "206 Partial Content",
+                                "multipart/byteranges; boundary=" RANGE_BOUNDARY, length, "", 0);
+    }
+    n += sprintf(buf + n, "%s", connection_hdr(hdrs));
+    printf("Response headers:\n");
+    printf("%s", buf);
+
+    /* 응답 전송 */
+    set_cork(fd, 1);
+    int rc = rio_writen(fd, buf, n) != n ? -1 : 1;
+    if (strcasecmp(method, "HEAD") == 0)
+        cnt = 0; // 응답 바디를 전송하지 않음
+    if (rc > 0 && cnt == 1 && send_body(fd, file, ranges[0][0], length) < 0)
+        rc = -1;
+    else if (rc > 0 && cnt > 1)
+    {
+        for (i = 0; i < cnt && rc > 0; i++)
+        {
+            n = range_part_header(part, filetype, ranges[i], filesize);
+            if (rio_writen(fd, part, n) != n || send_body(fd, file, ranges[i][0], ranges[i][1] - ranges[i][0] + 1) < 0)
+                rc = -1;
+        }
+        n = strlen("\r\n--" RANGE_BOUNDARY "--\r\n");
+        if (rc > 0 && rio_writen(fd, "\r\n--" RANGE_BOUNDARY "--\r\n", n) != n)
+            rc = -1;
+    }
+    set_cork(fd, 0);
+    return rc;
+}
+
+// Range 헤더(`bytes=0-99, 200-, -50`)를 파일 안의 [처음, 끝] 바이트 구간 목록(ranges)으로 바꾸는 함수
+// 구간 수를 리턴 (형식이 잘못됐거나 구간이 RANGES_MAX개보다 많으면 0, 파일 안의 구간이 하나도 없으면 -1)
+int parse_range(char *range, long filesize, long ranges[][2])
+{
+    char *p = range, *end;
+    long first, last;
+    int cnt = 0;
+
+    if (strncasecmp(p, "bytes=", 6))
+        return 0;
+    for (p += 6;; p++)
+    {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '-')
+        { // `-n`: 마지막 n바이트
+            if (!isdigit(p[1]))
+                return 0;
+            last = strtol(p + 1, &end, 10);
+            first = last >= filesize ? 0 : filesize - last;
+            last = filesize - 1;
+        }
+        else
+        { // `first-last`, `first-`: last를 생략하면 파일 끝까지
+            if (!isdigit(*p))
+                return 0;
+            first = strtol(p, &end, 10);
+            if (*end++ != '-')
+                return 0;
+            last = filesize - 1;
+            if (isdigit(*end) && (last = strtol(end, &end, 10)) < first)
+                return 0;
+            if (last >= filesize)
+                last = filesize - 1;
+        }
+        if (first < filesize && first <= last)
+        { // 파일 밖의 구간은 무시
+            if (cnt == RANGES_MAX)
+                return 0;
+            ranges[cnt][0] = first;
+            ranges[cnt++][1] = last;
+        }
+
+        for (p = end; *p == ' ' || *p == '\t'; p++)
+            ;
+        if (*p == '\0')
+            break;
+        if (*p != ',')
+            return 0;
+    }
+    return cnt ? cnt : -1;
+}
+
+// multipart/byteranges 응답에서 구간 데이터 앞에 붙는 경계와 파트 헤더를 buf에 쓰고 길이를 리턴
+int range_part_header(char *buf, char *filetype, long range[2], long filesize)
+{
+    return snprintf(buf, MAXLINE, "\r\n--%s\r\nContent-type: %s\r\nContent-Range: bytes %ld-%ld/%ld\r\n\r\n",
+                   RANGE_BOUNDARY, filetype, range[0], range[1], filesize);
+}
+
+// gzip으로 인코딩한 응답을 전송하는 함수 (file.gz sidecar가 있으면 그 파일을, 없으면 메모리에 압축해 둔 바디를 전송)
+// 압축한 응답이 없으면(압축하지 않는 타입, 큰 파일, 압축 효과 없음) 아무것도 보내지 않고 0을 리턴
+// 응답했으면 1, 전송 중에 클라이언트가 연결을 끊었으면 -1
+int serve_gzip(int fd, file_entry_t *file, char *method, request_hdrs_t *hdrs)
+{
+    char buf[MAXBUF], filetype[MAXLINE], gzname[MAXLINE + 3];
+    int n, gzip;
+    file_entry_t *gz;
+    char *conn = connection_hdr(hdrs);
+    struct iovec iov[3];
+
+    P(&file_mutex);
+    int load = file->gzip == GZIP_UNKNOWN && !file->loading; // 처음 gzip으로 요청된 파일이면 sidecar를 찾거나 압축해 둔다
+    if (load)
+        file->gzip = GZIP_LOADING; // 준비하는 동안 다른 요청은 원본 그대로 전송
+    gzip = file->gzip;
+    V(&file_mutex);
+    if (load) // stat과 압축은 잠금 밖에서 (그동안 다른 요청이 파일 캐시를 사용할 수 있도록)
+        gzip = load_gzip(file);
+
+    if (gzip == GZIP_MEMORY)
+    { // 메모리에 압축해 둔 바디
+        printf("Response headers:\n");
+        printf("%s%s", file->gz_header, conn);
+        iov[0].iov_base = file->gz_header;
+        iov[0].iov_len = file->gz_header_len;
+        iov[1].iov_base = conn;
+        iov[1].iov_len = strlen(conn);
+        iov[2].iov_base = file->gz_body;
+        iov[2].iov_len = strcasecmp(method, "HEAD") ? file->gz_len : 0;
+        return rio_writev(fd, iov, 3) < 0 ? -1 : 1;
+    }
+    if (gzip != GZIP_SIDECAR)
+        return 0;
+
+    /* file.gz sidecar: 파일 캐시로 열어서 정적 파일처럼 전송 (원본보다 오래된 sidecar는 사용하지 않음) */
+    sprintf(gzname, "%s.gz", file->filename);
+    if (!(gz = open_file(gzname)))
+        return 0;
+    if (gz->fd < 0 || !S_ISREG(gz->sbuf.st_mode) || gz->sbuf.st_mtime < file->sbuf.st_mtime)
+    {
+        release_file(gz);
+        return 0;
+    }
+    P(&file_mutex);
+    load = !gz->header && load_static(gz);
+    V(&file_mutex);
+    if (load)
+        load_body(gz);
+    get_filetype(file->filename, filetype); // 원본 파일의 타입
+    n = build_static_header(file, buf, "200 OK", filetype, gz->sbuf.st_size, "", 1); // validator는 원본 파일 기준
+    n += sprintf(buf + n, "%s", conn);
+    printf("Response headers:\n");
+    printf("%s", buf);
+    set_cork(fd, 1);
+    int rc = rio_writen(fd, buf, n) != n ? -1 : 1;
+    if (rc > 0 && strcasecmp(method, "HEAD") && send_body(fd, gz, 0, gz->sbuf.st_size) < 0)
+        rc = -1;
+    set_cork(fd, 0);
+    release_file(gz);
+    return rc;
+}
+
+// 파일의 gzip 응답을 준비하고 결정한 상태를 리턴하는 함수
+// serve_gzip이 GZIP_LOADING으로 표시한 엔트리에 대해 file_mutex를 잡지 않은 상태에서 호출 (압축 캐시 용량의 예약과 결과 반영만 잠금 안에서)
+// file.gz sidecar가 있으면 GZIP_SIDECAR, 메모리에 있는 작은 텍스트 파일은 한 번 압축해서 GZIP_MEMORY
+int load_gzip(file_entry_t *file)
+{
+    char buf[MAXBUF], filetype[MAXLINE], gzname[MAXLINE + 3];
+    struct stat sbuf;
+    z_stream zs;
+    int n, state = GZIP_NONE;
+    long bound = 0;
+    char *body = NULL;
+
+    get_filetype(file->filename, filetype);
+    sprintf(gzname, "%s.gz", file->filename);
+    if (!is_compressible(filetype))
+        ;
+    else if (stat(gzname, &sbuf) == 0 && S_ISREG(sbuf.st_mode) && sbuf.st_mtime >= file->sbuf.st_mtime)
+        state = GZIP_SIDECAR;
+    /* sidecar가 없으면 메모리에 보관한 바디를 압축 (압축 캐시 용량을 넘거나 크기가 줄지 않으면 압축하지 않음) */
+    else if (file->body && file->sbuf.st_size > 0)
+    {
+        memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK) // 15 + 16: gzip 형식
+        {
+            bound = deflateBound(&zs, file->sbuf.st_size);
+            P(&file_mutex); // 압축하는 동안 쓸 용량을 먼저 예약
+            if (file->stale || gzip_cache_used + bound > GZIP_CACHE_SIZE)
+                bound = 0;
+            gzip_cache_used += bound;
+            V(&file_mutex);
+            if (bound)
+            {
+                body = Malloc(bound);
+                zs.next_in = (Bytef *)file->body; // 바디는 엔트리를 사용하는 동안 바뀌지 않음
+                zs.avail_in = file->sbuf.st_size;
+                zs.next_out = (Bytef *)body;
+                zs.avail_out = bound;
+                if (deflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out < file->sbuf.st_size)
+                    state = GZIP_MEMORY;
+            }
+            deflateEnd(&zs);
+        }
+    }
+
+    if (state == GZIP_MEMORY)
+    {
+        body = Realloc(body, zs.total_out);
+        n = build_static_header(file, buf, "200 OK", filetype, zs.total_out, "", 1);
+    }
+
+    /* 결과 반영 (압축하는 동안 파일이 바뀌었으면 버림) */
+    P(&file_mutex);
+    gzip_cache_used -= bound;
+    if (state == GZIP_MEMORY && !file->stale)
+    {
+        file->gz_body = body;
+        file->gz_len = zs.total_out;
+        file->gz_header = Malloc(n + 1);
+        memcpy(file->gz_header, buf, n + 1);
+        file->gz_header_len = n;
+        gzip_cache_used += file->gz_len;
+        body = NULL;
+    }
+    else if (state == GZIP_MEMORY)
+        state = GZIP_NONE;
+    file->gzip = state;
+    V(&file_mutex);
+    free(body);
+    return state;
+}
+
+// Accept-Encoding 헤더 값이 gzip을 허용하는지 확인하는 함수 (`gzip;q=0`처럼 q가 0이면 허용하지 않음)
+int accepts_gzip(char *accept)
+{
+    char *p = accept, *end, *q;
+    int len;
+
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        len = strcspn(p, " ;,");    // 인코딩 이름 길이
+        end = p + strcspn(p, ","); // 이 항목의 끝 (`;q=` 파라미터 포함)
+        if ((len == 4 && !strncasecmp(p, "gzip", 4)) || (len == 6 && !strncasecmp(p, "x-gzip", 6)) || (len == 1 && *p == '*'))
+        {
+            q = strstr(p, "q=");
+            return !(q && q < end && strtod(q + 2, NULL) == 0);
+        }
+        p = end;
+    }
+    return 0;
+}
+
+// 압축해서 보낼 만한 컨텐츠 타입인지 확인하는 함수 (이미지, 동영상은 이미 압축된 형식)
+int is_compressible(char *filetype)
+{
+    return !strncmp(filetype, "text/", 5);
+}
+
+// 파일의 offset부터 length바이트를 소켓에 전송하는 함수
+// 메모리에 있는 파일은 메모리에서, 아니면 파일 내용을 사용자 메모리로 복사하지 않고 커널에서 바로 소켓으로 전송
+// 큰 파일은 DISK_CHUNK 단위로 나눠서, 한 구간을 전송하는 동안 디스크 스레드가 다음 구간을 미리 읽어둔다.
+// 모두 전송했으면 0, 전송 중에 연결이 끊어졌으면 -1을 리턴
+int send_body(int fd, file_entry_t *file, long offset, long length)
+{
+    char *srcp;
+    long chunk, sent, end = offset + length;
+    int rc;
+
+    if (file->body)
+        return rio_writen(fd, file->body + offset, length) != length ? -1 : 0;
+    chunk = length < DISK_CHUNK ? length : DISK_CHUNK;
+    if (length > DISK_CHUNK)
+        disk_readahead(file->fd, offset + chunk, length - chunk < DISK_CHUNK ? length - chunk : DISK_CHUNK);
+    if ((sent = send_file(fd, file->fd, offset, chunk)) < 0)
+    { // sendfile을 지원하지 않는 파일이면 가상메모리에 매핑해서 전송
+        srcp = Mmap(0, end, PROT_READ, MAP_PRIVATE, file->fd, 0);         // 파일을 가상메모리에 매핑
+        rc = rio_writen(fd, srcp + offset, length) != length ? -1 : 0; // 파일 내용을 클라이언트에게 전송 (응답 바디 전송)
+        Munmap(srcp, end);                                             // 매핑된 가상메모리 해제
+        return rc;
+    }
+    for (offset += sent; sent == chunk && offset < end; offset += sent) // 전송이 중간에 끊기면(연결 종료) 중단
+    {
+        chunk = end - offset < DISK_CHUNK ? end - offset : DISK_CHUNK;
+        if (offset + chunk < end) // 이번 구간을 전송하는 동안 다음 구간을 미리 읽음
+            disk_readahead(file->fd, offset + chunk, end - offset - chunk < DISK_CHUNK ? end - offset - chunk : DISK_CHUNK);
+        if ((sent = send_file(fd, file->fd, offset, chunk)) < 0)
+            break;
+    }
+    return offset == end ? 0 : -1;
+}
+
+// 파일 캐시 엔트리의 응답 헤더를 만드는 함수 (file_mutex를 잡은 상태에서 호출)
+// 작은 파일이면 바디를 보관할 캐시 용량을 예약하고 1을 리턴 (호출한 쪽이 잠금을 풀고 load_body로 바디를 읽음)
+// (헤더는 파일이 바뀌어 엔트리가 무효화될 때까지 그대로 사용)
+int load_static(file_entry_t *file)
+{
+    char buf[MAXBUF], filetype[MAXLINE];
+    int n, filesize = file->sbuf.st_size;
+
+    /* 응답 헤더 생성 */
+    get_filetype(file->filename, filetype); // 파일 타입 결정
+    n = build_static_header(file, buf, "200 OK", filetype, filesize, "", 0);
+    file->header = Malloc(n + 1);
+    memcpy(file->header, buf, n + 1);
+    file->header_len = n;
+
+    /* 캐시 용량 안의 작은 파일은 바디도 보관 */
+    if (file->stale || file->fd < 0 || filesize > STATIC_OBJECT_SIZE || static_cache_used + filesize > STATIC_CACHE_SIZE)
+        return 0;
+    static_cache_used += filesize;
+    file->loading = 1;
+    return 1;
+}
+
+// load_static이 용량을 예약한 엔트리의 바디를 메모리에 읽는 함수 (file_mutex를 잡지 않은 상태에서 호출)
+// 읽는 동안 다른 요청은 sendfile로 전송하고, 읽기에 실패하거나 그 사이 파일이 바뀌면 예약한 용량을 반환
+void load_body(file_entry_t *file)
+{
+    int n, filesize = file->sbuf.st_size;
+    char *body = Malloc(filesize);
+
+    for (n = 0; n < filesize;)
+    {
+        ssize_t rc = pread(file->fd, body + n, filesize - n, n);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0) // 읽기에 실패하면 바디는 보관하지 않음
+            break;
+        n += rc;
+    }
+    P(&file_mutex);
+    if (n == filesize && !file->stale)
+        file->body = body;
+    else
+    {
+        Free(body);
+        static_cache_used -= filesize;
+    }
+    file->loading = 0;
+    V(&file_mutex);
+}
+
+// 정적 파일의 응답 헤더를 buf에 만들고 길이를 리턴하는 함수
+// 요청마다 다른 Connection 줄과 헤더를 끝내는 빈 줄은 넣지 않음 (전송할 때 connection_hdr를 이어 붙임)
+// status: 상태 코드와 메시지, length: 응답 바디 길이, extra: 추가할 헤더 줄 (CRLF로 끝나야 함)
+// gzip: 1이면 gzip으로 인코딩한 응답 (ETag도 원본과 구분)
+int build_static_header(file_entry_t *file, char *buf, char *status, char *filetype, long length, char *extra, int gzip)
+{
+    int n = 0;
+
+    n += sprintf(buf + n, "HTTP/1.1 %s\r\n", status);            // 상태 코드
+    n += sprintf(buf + n, "Server: Tiny Web Server\r\n");        // 서버 이름
+    n += sprintf(buf + n, "Accept-Ranges: bytes\r\n");           // Range 요청 지원
+    n += sprintf(buf + n, "Content-length: %ld\r\n", length);    // 컨텐츠 길이
+    n += sprintf(buf + n, "Content-type: %s\r\n", filetype);     // 컨텐츠 타입
+    if (gzip)
+        n += sprintf(buf + n, "Content-Encoding: gzip\r\n");
+    n += sprintf(buf + n, "%s", extra);
+    n += static_cache_headers(file, buf + n, filetype, gzip); // 캐시 관련 헤더와 validator
+    return n;
+}
+
+// 정적 응답의 캐시 관련 헤더(Vary, Cache-Control, Last-Modified, ETag)를 buf에 쓰고 길이를 리턴하는 함수
+int static_cache_headers(file_entry_t *file, char *buf, char *filetype, int gzip)
+{
+    char modified[64], etag[64];
+    int n = 0;
+    struct tm tm;
+
+    strftime(modified, sizeof(modified), "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&file->sbuf.st_mtime, &tm));
+    static_etag(file, gzip, etag);
+    if (gzip || is_compressible(filetype))
+        n += sprintf(buf + n, "Vary: Accept-Encoding\r\n"); // Accept-Encoding에 따라 바디가 달라짐
+    if (static_max_age >= 0)
+        n += sprintf(buf + n, "Cache-Control: max-age=%d\r\n", static_max_age);
+    n += sprintf(buf + n, "Last-Modified: %s\r\n", modified); // 수정 시각
+    n += sprintf(buf + n, "ETag: %s\r\n", etag);
+    return n;
+}
+
+// 파일의 ETag(`"inode-크기-수정 시각"`, gzip 응답은 `-gz`를 붙임)를 etag에 쓰는 함수
+void static_etag(file_entry_t *file, int gzip, char *etag)
+{
+    sprintf(etag, "\"%lx-%lx-%lx%s\"", (unsigned long)file->sbuf.st_ino, (unsigned long)file->sbuf.st_size,
+            (unsigned long)file->sbuf.st_mtime, gzip ? "-gz" : "");
+}
+
+// sendfile로 파일(srcfd)의 start부터 length바이트를 소켓(fd)에 전송하는 함수
+// 처음부터 sendfile을 사용할 수 없으면 -1을 리턴하고, 전송 중에 연결이 끊어지면 전송한 만큼 리턴
+long send_file(int fd, int srcfd, long start, long length)
+{
+    off_t offset = start;
+    ssize_t n;
+
+    while (offset < start + length)
+    {
+        if ((n = sendfile(fd, srcfd, &offset, start + length - offset)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (offset == start && (errno == EINVAL || errno == ENOSYS))
+                return -1;
+            break;
+        }
+        if (n == 0) // 파일이 전송 중에 줄어든 경우
+            break;
+    }
+    return offset - start;
+}
+
+// 소켓의 TCP_CORK를 설정하는 함수 (설정하는 동안 데이터를 가득 찬 세그먼트로 모았다가, 해제할 때 전송)
+void set_cork(int fd, int on)
+{
+    setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+}
+
+void get_filetype(char *filename, char *filetype)
+{
+    if (strstr(filename, ".html"))
+        strcpy(filetype, "text/html");
+    else if (strstr(filename, ".gif"))
+        strcpy(filetype, "image/gif");
+    else if (strstr(filename, ".png"))
+        strcpy(filetype, "image/png");
+    else if (strstr(filename, ".jpg"))
+        strcpy(filetype, "image/jpg");
+    else if (strstr(filename, ".mp4"))
+        strcpy(filetype, "video/mp4");
+    else
+        strcpy(filetype, "text/plain");
+}
+
+void serve_dynamic(int fd, char *filename, char *cgiargs, char *method)
+{
+    char buf[MAXLINE], query_env[MAXLINE], method_env[MAXLINE];
+    char *cgi_env[] = {query_env, method_env, NULL};
+    pid_t pid;
+
+    sprintf(buf, "HTTP/1.0 200 OK\r\nServer: Tiny Web Server\r\n");
+    if (rio_writen(fd, buf, strlen(buf)) < 0) // 클라이언트가 이미 연결을 끊었으면 CGI 프로그램을 실행하지 않음
+        return;
+
+    // QUERY_STRING, REQUEST_METHOD 환경 변수를 URI에서 추출한 CGI 인수와 method로 설정하고,
+    // 자식 프로세스의 표준 출력을 클라이언트 소켓에 연결해서 filename 프로그램 실행
+    snprintf(query_env, MAXLINE, "QUERY_STRING=%s", cgiargs);
+    snprintf(method_env, MAXLINE, "REQUEST_METHOD=%s", method);
+    if ((pid = spawn_cgi(filename, -1, fd, cgi_env)) < 0)
+        return;
+    watch_child(pid); // 종료는 reaper 스레드가 회수 (자식이 소켓 사본을 가지고 있으므로 바로 연결을 닫아도 됨)
+}
+
+// filename 프로그램을 posix_spawn으로 실행하는 함수 (실패하면 -1 리턴)
+// fork처럼 tiny의 페이지 테이블을 복사하지 않아서(vfork 방식) tiny가 커져도 실행 비용이 일정하다.
+// in_fd, out_fd: 자식의 표준 입력, 표준 출력으로 연결할 fd (-1이면 그대로), cgi_env: 추가할 환경 변수
+pid_t spawn_cgi(char *filename, int in_fd, int out_fd, char **cgi_env)
+{
+    char *emptylist[] = {NULL}, **envp;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t sigdefault;
+    pid_t pid;
+    int n = 0, env_cnt = 0, rc;
+
+    /* 환경 변수: cgi_env + tiny의 환경 변수 (cgi_env와 이름이 같은 변수는 제외) */
+    while (environ[env_cnt])
+        env_cnt++;
+    envp = Malloc(sizeof(char *) * (env_cnt + 8));
+    for (char **env = cgi_env; *env; env++)
+        envp[n++] = *env;
+    for (char **env = environ; *env; env++)
+    {
+        int i, name_len = strcspn(*env, "=") + 1;
+        for (i = 0; cgi_env[i] && strncmp(cgi_env[i], *env, name_len); i++)
+            ;
+        if (!cgi_env[i])
+            envp[n++] = *env;
+    }
+    envp[n] = NULL;
+
+    /* 표준 입출력 연결 & tiny가 무시하는 SIGPIPE는 기본 동작으로 되돌림 */
+    posix_spawn_file_actions_init(&actions);
+    if (in_fd >= 0)
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    if (out_fd >= 0)
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    posix_spawnattr_init(&attr);
+    sigemptyset(&sigdefault);
+    sigaddset(&sigdefault, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &sigdefault);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    if ((rc = posix_spawn(&pid, filename, &actions, &attr, emptylist, envp)) != 0)
+    {
+        fprintf(stderr, "posix_spawn %s failed: %s\n", filename, strerror(rc));
+        pid = -1;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    Free(envp);
+    return pid;
+}
+
+// 자식 프로세스 회수 준비: pidfd를 reaper 스레드의 epoll에 등록 (pidfd를 쓸 수 없으면 바로 대기)
+void watch_child(pid_t pid)
+{
+    struct epoll_event event;
+    int pidfd;
+
+    if (reap_epfd < 0 || (pidfd = pidfd_open(pid, 0)) < 0)
+    {
+        Waitpid(pid, NULL, 0);
+        return;
+    }
+    event.events = EPOLLIN; // 자식이 종료되면 pidfd가 읽기 가능해짐
+    event.data.u64 = (uint64_t)pidfd << 32 | (uint32_t)pid;
+    if (epoll_ctl(reap_epfd, EPOLL_CTL_ADD, pidfd, &event) < 0)
+    {
+        Close(pidfd);
+        Waitpid(pid, NULL, 0);
+    }
+}
+
+// 종료된 CGI 자식 프로세스를 회수하는 스레드 (요청을 처리하는 스레드는 자식을 기다리지 않음)
+// 특정 pid만 회수하므로 persistent CGI worker처럼 따로 관리하는 자식에는 영향이 없다.
+void *reaper(void *vargp)
+{
+    struct epoll_event events[16];
+    int n;
+
+    Pthread_detach(pthread_self());
+    while (1)
+    {
+        if ((n = epoll_wait(reap_epfd, events, 16, -1)) < 0)
+            continue; // EINTR
+        for (int i = 0; i < n; i++)
+        {
+            int pidfd = events[i].data.u64 >> 32;
+            pid_t pid = (pid_t)(uint32_t)events[i].data.u64;
+            waitpid(pid, NULL, 0);
+            // 다른 자식이 exec 전에 pidfd 사본을 잠시 가지고 있을 수 있으므로 close 전에 직접 epoll에서 제거
+            epoll_ctl(reap_epfd, EPOLL_CTL_DEL, pidfd, NULL);
+            Close(pidfd);
+        }
+    }
+    return NULL;
+}
+
+// CGI 실행 준비: worker 슬롯 세마포어와 reaper 스레드 생성
+void init_cgi(void)
+{
+    pthread_t tid;
+
+    Sem_init(&cgi_mutex, 0, 1);
+    Sem_init(&handler_mutex, 0, 1);
+    if ((reap_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        fprintf(stderr, "epoll_create1 failed, CGI children are reaped synchronously\n");
+    else
+        Pthread_create(&tid, NULL, reaper, NULL);
+}
+
+// 파일 캐시 초기화: inotify를 사용할 수 없으면 FILE_CACHE_TTL 동안만 stat 결과를 사용
+void init_file_cache(void)
+{
+    Sem_init(&file_mutex, 0, 1);
+    if ((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+        fprintf(stderr, "inotify_init1 failed, file cache entries expire after %ds\n", FILE_CACHE_TTL);
+}
+
+// filename의 열린 fd와 stat 결과를 반환하는 함수 (파일이 없으면 NULL)
+// 캐시에 있으면 파일 시스템을 거치지 않고, 없으면 열어서 가장 오래 사용하지 않은 엔트리와 교체한다.
+// 사용이 끝나면 release_file을 호출해야 한다.
+file_entry_t *open_file(char *filename)
+{
+    file_entry_t *entry, *victim = NULL;
+    struct stat sbuf;
+    int srcfd;
+
+    P(&file_mutex);
+    drain_file_events(); // 바뀐 파일의 엔트리 무효화
+    for (entry = file_cache; entry < file_cache + FILE_CACHE_SIZE; entry++)
+    {
+        if (entry->stale || strcmp(entry->filename, filename))
+            continue;
+        if (entry->wd < 0 && time(NULL) - entry->loaded >= FILE_CACHE_TTL)
+        { // inotify로 감시하지 않는 엔트리는 TTL이 지나면 다시 stat
+            invalidate_file(entry);
+            break;
+        }
+        entry->refcnt++;
+        entry->last_used = ++file_clock;
+        V(&file_mutex);
+        return entry;
+    }
+
+    /* 캐시에 없는 파일: 열어서 fstat (읽을 수 없는 파일은 stat만 사용) */
+    if ((srcfd = open(filename, O_RDONLY | O_CLOEXEC)) >= 0)
+    {
+        fstat(srcfd, &sbuf);
+        if (sbuf.st_size > STATIC_OBJECT_SIZE) // 메모리에 보관하지 않는 큰 파일은 커널 readahead 창을 크게
+            posix_fadvise(srcfd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    else if (stat(filename, &sbuf) < 0)
+    {
+        V(&file_mutex);
+        return NULL;
+    }
+
+    for (entry = file_cache; entry < file_cache + FILE_CACHE_SIZE; entry++)
+    { // 사용 중이 아니면서 비어 있거나 가장 오래 사용하지 않은 엔트리
+        if (entry->refcnt)
+            continue;
+        if (!victim || entry->last_used < victim->last_used)
+            victim = entry;
+    }
+    if (victim)
+    {
+        if (!victim->stale && victim->filename[0])
+            invalidate_file(victim);
+        victim->stale = 0;
+    }
+    else
+    { // 모든 엔트리가 사용 중이면 캐싱하지 않고 이번 요청에만 사용
+        victim = Malloc(sizeof(file_entry_t));
+        victim->stale = 1;
+    }
+
+    strcpy(victim->filename, filename);
+    victim->fd = srcfd;
+    victim->sbuf = sbuf;
+    victim->loaded = time(NULL);
+    victim->last_used = ++file_clock;
+    victim->refcnt = 1;
+    victim->wd = -1;
+    victim->header = victim->body = NULL;
+    victim->gz_header = victim->gz_body = NULL;
+    victim->gzip = GZIP_UNKNOWN;
+    victim->loading = 0;
+    if (inotify_fd >= 0 && !victim->stale)
+        victim->wd = inotify_add_watch(inotify_fd, filename, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+    V(&file_mutex);
+    return victim;
+}
+
+// open_file로 얻은 엔트리의 사용이 끝났음을 알리는 함수
+// 사용 중에 무효화된 엔트리는 마지막 사용이 끝날 때 fd와 메모리를 반환한다.
+void release_file(file_entry_t *entry)
+{
+    P(&file_mutex);
+    if (--entry->refcnt == 0 && entry->stale)
+    {
+        free_file(entry);
+        if (entry < file_cache || entry >= file_cache + FILE_CACHE_SIZE) // 캐싱하지 않은 엔트리
+            Free(entry);
+    }
+    V(&file_mutex);
+}
+
+// inotify 이벤트를 모두 읽어서 바뀐 파일의 엔트리를 무효화하는 함수 (이벤트가 없으면 바로 리턴)
+void drain_file_events(void)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event *event;
+    ssize_t n;
+
+    if (inotify_fd < 0)
+        return;
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0)
+        for (char *ptr = buf; ptr < buf + n; ptr += sizeof(struct inotify_event) + event->len)
+        {
+            event = (struct inotify_event *)ptr;
+            for (file_entry_t *entry = file_cache; entry < file_cache + FILE_CACHE_SIZE; entry++)
+                if (!entry->stale && entry->filename[0] && entry->wd == event->wd)
+                    invalidate_file(entry);
+        }
+}
+
+// 엔트리를 캐시에서 제거하는 함수 (사용 중이면 fd와 메모리는 release_file에서 반환한다)
+void invalidate_file(file_entry_t *entry)
+{
+    if (entry->wd >= 0)
+        inotify_rm_watch(inotify_fd, entry->wd);
+    entry->wd = -1;
+    entry->stale = 1;
+    if (!entry->refcnt)
+        free_file(entry);
+}
+
+// 엔트리의 fd를 닫고 헤더와 바디 메모리를 반환하는 함수
+void free_file(file_entry_t *entry)
+{
+    if (entry->fd >= 0)
+        Close(entry->fd);
+    entry->fd = -1;
+    if (entry->body)
+        static_cache_used -= entry->sbuf.st_size;
+    if (entry->gz_body)
+        gzip_cache_used -= entry->gz_len;
+    free(entry->header);
+    free(entry->body);
+    free(entry->gz_header);
+    free(entry->gz_body);
+    entry->header = entry->body = NULL;
+    entry->gz_header = entry->gz_body = NULL;
+}
+
+// persistent CGI worker로 동적 컨텐츠를 제공하는 함수
+// 요청마다 fork/exec 하지 않고, 미리 띄워둔 CGI 프로세스에 `method query\n`을 보내고 `TINY-CGI 길이\n` 뒤의 응답을 받는다.
+// worker를 사용할 수 없으면 클라이언트에 아무것도 보내지 않고 0을 리턴 (serve_dynamic으로 처리)
+int serve_cgi_worker(int fd, char *filename, struct stat *sbuf, char *cgiargs, char *method)
+{
+    char buf[MAXLINE], *body;
+    int n, len;
+    struct iovec iov[2];
+    cgi_worker_t *worker;
+
+    if (!(worker = acquire_cgi_worker(filename, sbuf)))
+        return 0;
+
+    /* 요청 전송 & 응답 길이 수신 */
+    n = snprintf(buf, MAXLINE, "%s %s\n", method, cgiargs);
+    if (rio_writen(worker->fd, buf, n) != n || rio_readlineb(&worker->rio, buf, MAXLINE) <= 0)
+    { // worker가 종료된 경우
+        stop_cgi_worker(worker, 0);
+        return 0;
+    }
+    if (sscanf(buf, "TINY-CGI %d", &len) != 1 || len < 0)
+    { // persistent 모드를 지원하지 않는 CGI 프로그램 (다음부터는 fork/exec로 처리)
+        stop_cgi_worker(worker, 1);
+        return 0;
+    }
+
+    /* 응답 수신 */
+    body = Malloc(len);
+    if (rio_readnb(&worker->rio, body, len) != len)
+    {
+        Free(body);
+        stop_cgi_worker(worker, 0);
+        return 0;
+    }
+    release_cgi_worker(worker);
+
+    /* 상태 라인과 CGI 응답을 한 번에 전송 */
+    n = sprintf(buf, "HTTP/1.0 200 OK\r\nServer: Tiny Web Server\r\n");
+    iov[0].iov_base = buf;
+    iov[0].iov_len = n;
+    iov[1].iov_base = body;
+    iov[1].iov_len = len;
+    rio_writev(fd, iov, 2); // 응답 후 연결을 닫으므로 전송 실패는 무시 (요청은 처리한 것으로 봄)
+    Free(body);
+    return 1;
+}
+
+// filename을 실행 중인 쉬는 worker를 찾아 사용 중으로 표시하는 함수 (없으면 새로 실행)
+// worker를 쓸 수 없으면(모두 사용 중, persistent 모드 미지원) NULL 리턴
+cgi_worker_t *acquire_cgi_worker(char *filename, struct stat *sbuf)
+{
+    cgi_worker_t *worker, *victim = NULL;
+    int sv[2];
+    char *worker_env[] = {"TINY_CGI_WORKER=1", NULL};
+    pid_t pid;
+
+    P(&cgi_mutex);
+    for (worker = cgi_workers; worker < cgi_workers + cgi_worker_cnt; worker++)
+    {
+        if (!worker->pid || strcmp(worker->filename, filename))
+            continue;
+        if (worker->mtime != sbuf->st_mtime || worker->ino != sbuf->st_ino)
+        { // CGI 프로그램이 바뀐 경우: 쉬고 있는 이전 버전 worker는 종료
+            if (!worker->busy)
+                clear_cgi_worker(worker);
+            continue;
+        }
+        if (worker->pid < 0)
+        { // persistent 모드를 지원하지 않는 프로그램
+            V(&cgi_mutex);
+            return NULL;
+        }
+        if (!worker->busy)
+        {
+            worker->busy = 1;
+            V(&cgi_mutex);
+            return worker;
+        }
+    }
+
+    /* 빈 슬롯 혹은 다른 프로그램의 쉬는 worker를 골라 새 worker 실행 */
+    for (worker = cgi_workers; worker < cgi_workers + cgi_worker_cnt && !victim; worker++)
+        if (!worker->pid)
+            victim = worker;
+    for (worker = cgi_workers; worker < cgi_workers + cgi_worker_cnt && !victim; worker++)
+        if (!worker->busy)
+            victim = worker;
+    if (!victim || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+    {
+        V(&cgi_mutex);
+        return NULL;
+    }
+    if (victim->pid)
+        clear_cgi_worker(victim);
+
+    pid = spawn_cgi(filename, sv[1], sv[1], worker_env); // worker의 표준 입출력을 tiny와 연결된 소켓으로 변경
+    Close(sv[1]);
+    if (pid < 0)
+    {
+        Close(sv[0]);
+        V(&cgi_mutex);
+        return NULL;
+    }
+    victim->pid = pid;
+    strcpy(victim->filename, filename);
+    victim->fd = sv[0];
+    victim->mtime = sbuf->st_mtime;
+    victim->ino = sbuf->st_ino;
+    victim->busy = 1;
+    Rio_readinitb(&victim->rio, sv[0]);
+    V(&cgi_mutex);
+    return victim;
+}
+
+// 사용이 끝난 worker를 다시 쉬는 상태로 만드는 함수
+void release_cgi_worker(cgi_worker_t *worker)
+{
+    P(&cgi_mutex);
+    worker->busy = 0;
+    V(&cgi_mutex);
+}
+
+// 사용 중인 worker에 문제가 생겨 종료하는 함수 (unsupported: persistent 모드를 지원하지 않는 프로그램으로 기록)
+void stop_cgi_worker(cgi_worker_t *worker, int unsupported)
+{
+    P(&cgi_mutex);
+    clear_cgi_worker(worker);
+    if (unsupported)
+        worker->pid = -1; // 슬롯에 filename, mtime을 남겨서 프로그램이 바뀌기 전까지 worker를 띄우지 않음
+    V(&cgi_mutex);
+}
+
+// worker 프로세스를 종료하고 슬롯을 비우는 함수 (cgi_mutex를 잡은 상태에서 호출)
+void clear_cgi_worker(cgi_worker_t *worker)
+{
+    if (worker->pid > 0)
+    {
+        Close(worker->fd);
+        kill(worker->pid, SIGTERM);
+        watch_child(worker->pid); // 종료가 늦어도 cgi_mutex를 잡은 채 기다리지 않도록 reaper 스레드가 회수
+    }
+    worker->pid = 0;
+    worker->busy = 0;
+}
+
+// filename 프로그램의 플러그인 핸들러(`filename.so`)를 찾는 함수 (없으면 NULL)
+// 처음 요청될 때 한 번만 dlopen하고, 플러그인이 없다는 결과도 기억해서 다시 찾지 않는다.
+cgi_handler_t lookup_handler(char *filename)
+{
+    char so_name[MAXLINE + 3];
+    handler_entry_t *entry;
+    cgi_handler_t handler = NULL;
+
+    P(&handler_mutex);
+    for (entry = handlers; entry < handlers + handler_cnt; entry++)
+        if (!strcmp(entry->filename, filename))
+            break;
+    if (entry == handlers + handler_cnt && handler_cnt < HANDLERS_MAX)
+    { // 처음 요청된 프로그램: 플러그인 로드
+        handler_cnt++;
+        strcpy(entry->filename, filename);
+        sprintf(so_name, "%s.so", filename);
+        if (access(so_name, R_OK) == 0)
+        {
+            if ((entry->dl = dlopen(so_name, RTLD_NOW | RTLD_LOCAL)))
+                entry->handler = (cgi_handler_t)dlsym(entry->dl, HANDLER_SYMBOL);
+            if (!entry->handler)
+                fprintf(stderr, "Tiny couldn't load handler %s: %s\n", so_name, dlerror());
+        }
+    }
+    if (entry < handlers + handler_cnt)
+        handler = entry->handler;
+    V(&handler_mutex);
+    return handler;
+}
+
+// 플러그인 핸들러로 동적 컨텐츠를 제공하는 함수 (fork/exec 없이 현재 스레드에서 핸들러 호출)
+// 플러그인이 없거나 핸들러가 실패하면 클라이언트에 아무것도 보내지 않고 0을 리턴 (CGI 프로그램으로 처리)
+int serve_handler(int fd, char *filename, char *cgiargs, char *method)
+{
+    char buf[MAXLINE], *body;
+    int n, len;
+    struct iovec iov[2];
+    cgi_handler_t handler;
+
+    if (!(handler = lookup_handler(filename)))
+        return 0;
+
+    body = Malloc(HANDLER_BUFSIZE);
+    if ((len = handler(cgiargs, method, body, HANDLER_BUFSIZE)) < 0 || len > HANDLER_BUFSIZE)
+    {
+        Free(body);
+        return 0;
+    }
+
+    /* 상태 라인과 핸들러 응답을 한 번에 전송 */
+    n = sprintf(buf, "HTTP/1.0 200 OK\r\nServer: Tiny Web Server\r\n");
+    iov[0].iov_base = buf;
+    iov[0].iov_len = n;
+    iov[1].iov_base = body;
+    iov[1].iov_len = len;
+    rio_writev(fd, iov, 2); // 응답 후 연결을 닫으므로 전송 실패는 무시 (요청은 처리한 것으로 봄)
+    Free(body);
+    return 1;
+}
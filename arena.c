@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "csapp.h"
+#include "arena.h"
+
+// 블록 헤더 크기를 정렬 단위로 맞춰 첫 할당 주소도 정렬되도록 함
+#define ALIGN_UP(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define BLOCK_HEADER_SIZE ALIGN_UP(sizeof(arena_block_t))
+
+static arena_block_t *new_block(size_t size, arena_block_t *next);
+
+// 기본 블록 하나를 가진 아레나를 만드는 함수 (기본 블록은 `arena_reset` 후에도 재사용)
+void arena_init(arena_t *arena)
+{
+  arena->head = new_block(ARENA_BLOCK_SIZE, NULL);
+}
+
+// `size` 바이트를 할당하는 함수: 현재 블록에 공간이 있으면 포인터만 옮기고, 부족하면 새 블록을 연결
+// 기본 블록보다 큰 요청(ex. 큰 Response Body)은 그 크기만큼의 블록을 따로 만듦 (크기가 넘치면 NULL 반환)
+void *arena_alloc(arena_t *arena, size_t size)
+{
+  arena_block_t *block = arena->head;
+
+  if (size > SIZE_MAX - BLOCK_HEADER_SIZE - ARENA_ALIGN) // 정렬하거나 블록 헤더를 더하면 넘치는 크기
+    return NULL;
+  size = ALIGN_UP(size);
+  if (block->size - block->used < size)
+    block = arena->head = new_block(size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE, block);
+
+  void *ptr = (char *)block + BLOCK_HEADER_SIZE + block->used;
+  block->used += size;
+  return ptr;
+}
+
+// 기본 블록만 남기고 모든 블록을 반환하는 함수 (요청 하나를 마칠 때마다 호출)
+void arena_reset(arena_t *arena)
+{
+  arena_block_t *block = arena->head;
+
+  while (block->next)
+  {
+    arena_block_t *next = block->next;
+    Free(block);
+    block = next;
+  }
+  block->used = 0;
+  arena->head = block;
+}
+
+static arena_block_t *new_block(size_t size, arena_block_t *next)
+{
+  arena_block_t *block = Malloc(BLOCK_HEADER_SIZE + size);
+  block->next = next;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
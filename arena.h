@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+#include "csapp.h"
+
+#define ARENA_BLOCK_SIZE 131072 // 기본 블록 크기 (요청 하나의 버퍼와 작은 Body가 들어가는 크기)
+#define ARENA_ALIGN 16          // 할당 주소 정렬 단위
+
+// 아레나 블록: 헤더 뒤에 `size` 바이트의 공간이 이어짐
+typedef struct arena_block_t
+{
+  struct arena_block_t *next; // 이전에 할당한 블록 (마지막은 처음 만든 기본 블록)
+  size_t size;
+  size_t used;
+} arena_block_t;
+
+// 연결 하나를 처리하는 동안 사용하는 bump 할당기 (개별 해제 없이 `arena_reset`으로 한 번에 반환)
+typedef struct
+{
+  arena_block_t *head; // 현재 할당 중인 블록
+} arena_t;
+
+void arena_init(arena_t *arena);
+void *arena_alloc(arena_t *arena, size_t size);
+void arena_reset(arena_t *arena);
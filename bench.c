@@ -0,0 +1,519 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "csapp.h"
+
+#define CONNS_MAX 1024 // 최대 동시 연결 수 (연결마다 스레드 하나)
+#define MIX_MAX 64     // 요청 mix에 넣을 수 있는 최대 경로 수
+#define BENCH_DURATION 10 // 기본 측정 시간(초)
+#define BENCH_TIMEOUT 5   // 응답을 기다리는 기본 시간(초)
+
+/* HDR 히스토그램: 2의 거듭제곱 구간마다 같은 개수의 칸을 두어 값의 크기와 상관없이 상대 오차를 일정하게 유지 */
+#define HIST_SUB_BITS 10 // 구간 하나의 칸 수의 log2 (1024칸: 유효숫자 약 3자리)
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT / 2)
+#define HIST_SHIFT_MAX 27 // 기록할 수 있는 최대 지연 2^(10+27)us (약 38시간)
+#define HIST_BUCKETS (HIST_SUB_COUNT + HIST_SHIFT_MAX * HIST_HALF_COUNT)
+
+// 지연 시간(us) 분포
+typedef struct
+{
+  unsigned int counts[HIST_BUCKETS];
+  long total;
+  long min, max;
+  double sum;
+} hist_t;
+
+// 요청 mix의 경로와 가중치
+typedef struct
+{
+  char path[MAXLINE];
+  int weight;
+} mix_entry_t;
+
+// 연결 하나를 담당하는 스레드의 측정 결과
+typedef struct
+{
+  int id;
+  hist_t *hist;
+  long requests; // 응답을 끝까지 받은 요청 수
+  long errors;   // 연결 실패, 타임아웃, 잘못된 응답
+  long bytes;    // 받은 응답 바디 크기
+  long connects; // 연결을 새로 맺은 횟수 (keep-alive로 재사용하면 줄어듦)
+  long status[6]; // 응답 상태 코드 종류별 개수 (1xx~5xx, 0: 알 수 없는 상태)
+} worker_t;
+
+void *worker(void *vargp);
+int do_request(int fd, rio_t *rio, char *path, int *status, long *bytes, int *keep);
+long read_body(rio_t *rio, long length);
+long read_chunked(rio_t *rio);
+char *pick_path(unsigned int *seed);
+int take_request(void);
+long now_us(void);
+void sleep_until(long when);
+void split_hostport(char *spec, char *host, char *port);
+void hist_record(hist_t *hist, long value);
+void hist_merge(hist_t *dst, hist_t *src);
+long hist_percentile(hist_t *hist, double percentile);
+void print_distribution(hist_t *hist);
+static int hist_index(long value);
+static long hist_value(int index);
+
+static char host[MAXLINE], port[MAXLINE];                 // 요청을 보낼 서버
+static char connect_host[MAXLINE], connect_port[MAXLINE]; // 실제로 연결할 곳 (proxy 모드면 Proxy)
+static int use_proxy;                                     // 1이면 Proxy에 절대 URI로 요청
+static mix_entry_t mix[MIX_MAX];
+static int mix_cnt, mix_weight; // 요청 mix의 경로 수, 가중치 합
+static int nconns = 1;           // 동시 연결 수
+static int keep_alive;           // 1이면 HTTP/1.1 keep-alive로 연결을 재사용
+static double rate;              // open-loop 모드의 초당 요청 수 (0이면 closed-loop)
+static int timeout = BENCH_TIMEOUT;
+static long start_time, end_time; // 측정 시작, 종료 시각(us)
+static long request_limit;        // 보낼 요청 수 (0이면 시간으로만 제한)
+static long requests_taken;       // 지금까지 시작한 요청 수
+static sem_t limit_mutex;         // requests_taken을 보호하는 세마포어
+
+int main(int argc, char **argv)
+{
+  int opt, duration = BENCH_DURATION, print_dist = 0, bad_opt = 0;
+  char *weight;
+  worker_t *workers;
+  hist_t *total;
+  long requests = 0, errors = 0, bytes = 0, connects = 0, status[6] = {0};
+  signal(SIGPIPE, SIG_IGN); // 서버가 먼저 연결을 닫아도 종료하지 않음
+
+  // `-c conns`: 동시 연결 수 (연결마다 스레드 하나), `-d sec`: 측정 시간, `-n requests`: 보낼 요청 수 (먼저 도달하는 쪽에서 종료)
+  // `-r rate`: open-loop 모드의 전체 초당 요청 수 (지정하지 않으면 응답을 받자마자 다음 요청을 보내는 closed-loop)
+  // `-k`: keep-alive로 연결 재사용, `-x host:port`: Proxy를 거쳐 요청, `-t sec`: 응답 타임아웃
+  // `-P`: HDR 히스토그램 백분위 분포 전체 출력
+  while ((opt = getopt(argc, argv, "c:d:n:r:kx:t:P")) != -1)
+  {
+    if (opt == 'c')
+      nconns = atoi(optarg);
+    else if (opt == 'd')
+      duration = atoi(optarg);
+    else if (opt == 'n')
+      request_limit = atol(optarg);
+    else if (opt == 'r')
+      rate = atof(optarg);
+    else if (opt == 'k')
+      keep_alive = 1;
+    else if (opt == 'x')
+    {
+      split_hostport(optarg, connect_host, connect_port);
+      use_proxy = 1;
+    }
+    else if (opt == 't')
+      timeout = atoi(optarg);
+    else if (opt == 'P')
+      print_dist = 1;
+    else
+      bad_opt = 1;
+  }
+  if (bad_opt || argc - optind < 2 || nconns < 1 || nconns > CONNS_MAX || duration < 1 || request_limit < 0 || rate < 0 ||
+      timeout < 1 || argc - optind - 1 > MIX_MAX)
+  {
+    fprintf(stderr, "usage: %s [-c conns] [-d sec] [-n requests] [-r rate] [-k] [-x proxy_host:port] [-t timeout] [-P] <host:port> <path>[@weight] ...\n", argv[0]);
+    exit(1);
+  }
+
+  split_hostport(argv[optind], host, port);
+  if (!use_proxy)
+  {
+    strcpy(connect_host, host);
+    strcpy(connect_port, port);
+  }
+  // 요청 mix: `/home.html@9 /godzilla.gif@1`처럼 경로마다 가중치를 지정 (지정하지 않으면 1)
+  for (int i = optind + 1; i < argc; i++, mix_cnt++)
+  {
+    snprintf(mix[mix_cnt].path, MAXLINE, "%s", argv[i]);
+    mix[mix_cnt].weight = 1;
+    if ((weight = strrchr(mix[mix_cnt].path, '@')))
+    {
+      *weight++ = '\0';
+      mix[mix_cnt].weight = atoi(weight);
+    }
+    if (mix[mix_cnt].path[0] != '/' || mix[mix_cnt].weight < 1 || strlen(mix[mix_cnt].path) + strlen(argv[optind]) > MAXLINE / 2)
+    {
+      fprintf(stderr, "bad path: %s\n", argv[i]);
+      exit(1);
+    }
+    mix_weight += mix[mix_cnt].weight;
+  }
+
+  printf("Running %ds test @ http://%s:%s\n", duration, host, port);
+  if (use_proxy)
+    printf("  via proxy %s:%s\n", connect_host, connect_port);
+  if (rate > 0)
+    printf("  %d connections, open-loop %.1f req/s, %s\n", nconns, rate, keep_alive ? "keep-alive" : "connection per request");
+  else
+    printf("  %d connections, closed-loop, %s\n", nconns, keep_alive ? "keep-alive" : "connection per request");
+
+  Sem_init(&limit_mutex, 0, 1);
+  workers = Calloc(nconns, sizeof(worker_t));
+  start_time = now_us();
+  end_time = start_time + duration * 1000000L;
+  pthread_t *tids = Malloc(nconns * sizeof(pthread_t));
+  for (int i = 0; i < nconns; i++)
+  {
+    workers[i].id = i;
+    workers[i].hist = Calloc(1, sizeof(hist_t));
+    Pthread_create(&tids[i], NULL, worker, &workers[i]);
+  }
+
+  /* 스레드별 결과 합산 */
+  total = Calloc(1, sizeof(hist_t));
+  for (int i = 0; i < nconns; i++)
+  {
+    Pthread_join(tids[i], NULL);
+    hist_merge(total, workers[i].hist);
+    requests += workers[i].requests;
+    errors += workers[i].errors;
+    bytes += workers[i].bytes;
+    connects += workers[i].connects;
+    for (int s = 0; s < 6; s++)
+      status[s] += workers[i].status[s];
+    Free(workers[i].hist);
+  }
+  double elapsed = (now_us() - start_time) / 1e6;
+
+  printf("Requests: %ld  Errors: %ld  Connects: %ld  Duration: %.2fs\n", requests, errors, connects, elapsed);
+  printf("Throughput: %.1f req/s  %.2f MB/s\n", requests / elapsed, bytes / elapsed / 1048576);
+  printf("Status: 1xx=%ld 2xx=%ld 3xx=%ld 4xx=%ld 5xx=%ld other=%ld\n", status[1], status[2], status[3], status[4], status[5],
+         status[0]);
+  if (total->total)
+  {
+    printf("Latency (us): min=%ld mean=%.0f p50=%ld p90=%ld p99=%ld p99.9=%ld p99.99=%ld max=%ld\n", total->min,
+           total->sum / total->total, hist_percentile(total, 50), hist_percentile(total, 90), hist_percentile(total, 99),
+           hist_percentile(total, 99.9), hist_percentile(total, 99.99), total->max);
+    if (print_dist)
+      print_distribution(total);
+  }
+  Free(total);
+  Free(tids);
+  Free(workers);
+  exit(errors && !requests);
+}
+
+// 연결 하나로 요청을 반복해서 보내는 스레드
+// closed-loop: 응답을 받자마자 다음 요청, open-loop: 연결마다 rate / nconns의 일정한 간격으로 요청
+// open-loop의 지연 시간은 요청을 보내기로 예정한 시각부터 재므로, 서버가 밀려서 늦게 보낸 요청의 대기 시간도 포함됨
+void *worker(void *vargp)
+{
+  worker_t *w = vargp;
+  unsigned int seed = w->id + 1; // 스레드마다 다르지만 실행할 때마다 같은 요청 순서
+  long interval = rate > 0 ? (long)(nconns * 1e6 / rate) : 0, next = start_time + (interval * w->id) / nconns;
+  int fd = -1, reused, status, keep, rc;
+  long sched, bytes;
+  rio_t rio;
+  struct timeval tv = {timeout, 0};
+
+  while (now_us() < end_time && take_request())
+  {
+    if (interval)
+    { // 예정 시각까지 대기 (이미 지났으면 바로 전송)
+      sleep_until(next);
+      if ((sched = next) >= end_time)
+        break;
+      next += interval;
+    }
+    else
+      sched = now_us();
+    char *path = pick_path(&seed);
+
+    do
+    {
+      reused = fd >= 0;
+      if (fd < 0)
+      {
+        if ((fd = open_clientfd(connect_host, connect_port)) < 0)
+        {
+          rc = -1;
+          break;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        rio_readinitb(&rio, fd);
+        w->connects++;
+      }
+      if ((rc = do_request(fd, &rio, path, &status, &bytes, &keep)) < 0 || !keep)
+      {
+        Close(fd);
+        fd = -1;
+      }
+    } while (rc == -2 && reused); // keep-alive 연결이 유휴 상태에서 닫혔으면 새 연결로 다시 요청
+
+    if (rc < 0)
+    {
+      w->errors++;
+      if (!interval)
+        usleep(1000); // 서버가 연결을 받지 못하는 동안 연결 시도만 반복하지 않도록
+      continue;
+    }
+    hist_record(w->hist, now_us() - sched);
+    w->requests++;
+    w->bytes += bytes;
+    w->status[status >= 100 && status < 600 ? status / 100 : 0]++;
+  }
+  if (fd >= 0)
+    Close(fd);
+  return NULL;
+}
+
+// 요청을 보내고 응답을 끝까지 읽는 함수 (성공하면 0)
+// 응답이 오기 전에 연결이 닫혔으면 -2, 그 밖의 오류는 -1을 리턴
+// status: 응답 상태 코드, bytes: 받은 바디 크기, keep: 응답 후 연결을 재사용할 수 있으면 1
+int do_request(int fd, rio_t *rio, char *path, int *status, long *bytes, int *keep)
+{
+  char buf[MAXLINE], name[MAXLINE], value[MAXLINE];
+  int n = 0, minor, chunked = 0;
+  long length = -1;
+  ssize_t rc;
+
+  /* 요청 전송 (Proxy에는 절대 URI로 요청) */
+  if (use_proxy)
+    n += snprintf(buf + n, MAXLINE - n, "GET http://%s:%s%s HTTP/1.%d\r\n", host, port, path, keep_alive);
+  else
+    n += snprintf(buf + n, MAXLINE - n, "GET %s HTTP/1.%d\r\n", path, keep_alive);
+  n += snprintf(buf + n, MAXLINE - n, "Host: %s:%s\r\n", host, port);
+  n += snprintf(buf + n, MAXLINE - n, "User-Agent: bench\r\n");
+  n += snprintf(buf + n, MAXLINE - n, "Connection: %s\r\n\r\n", keep_alive ? "keep-alive" : "close");
+  if (rio_writen(fd, buf, n) != n)
+    return -2;
+
+  /* 상태 줄 */
+  if ((rc = rio_readlineb(rio, buf, MAXLINE)) <= 0)
+    return -2;
+  if (sscanf(buf, "HTTP/1.%d %d", &minor, status) != 2)
+    return -1;
+  *keep = keep_alive && minor == 1; // HTTP/1.1 응답은 Connection: close가 없으면 연결 유지
+
+  /* 응답 헤더: 바디 길이와 연결 유지 여부 */
+  while ((rc = rio_readlineb(rio, buf, MAXLINE)) > 0 && strcmp(buf, "\r\n") && strcmp(buf, "\n"))
+  {
+    if (sscanf(buf, "%[^:]: %[^\r\n]", name, value) != 2)
+      continue;
+    if (!strcasecmp(name, "Content-Length"))
+      length = atol(value);
+    else if (!strcasecmp(name, "Transfer-Encoding") && strstr(value, "chunked"))
+      chunked = 1;
+    else if (!strcasecmp(name, "Connection") && !strcasecmp(value, "close"))
+      *keep = 0;
+    else if (!strcasecmp(name, "Connection") && !strcasecmp(value, "keep-alive") && keep_alive)
+      *keep = 1;
+  }
+  if (rc <= 0)
+    return -1;
+
+  /* 응답 바디 (길이를 알 수 없으면 연결이 닫힐 때까지) */
+  if (*status == 204 || *status == 304 || *status / 100 == 1)
+    *bytes = 0;
+  else if (chunked)
+    *bytes = read_chunked(rio);
+  else
+  {
+    if (length < 0)
+      *keep = 0;
+    *bytes = read_body(rio, length);
+  }
+  return *bytes < 0 ? -1 : 0;
+}
+
+// 바디 length바이트를 읽어서 버리는 함수 (length가 음수면 연결이 닫힐 때까지, 중간에 끊기면 -1)
+long read_body(rio_t *rio, long length)
+{
+  char buf[MAXBUF];
+  long total = 0;
+  ssize_t rc;
+
+  while (length < 0 || total < length)
+  {
+    size_t want = length < 0 || length - total > MAXBUF ? MAXBUF : length - total;
+    if ((rc = rio_readnb(rio, buf, want)) <= 0)
+      return length < 0 && rc == 0 ? total : -1;
+    total += rc;
+  }
+  return total;
+}
+
+// chunked 인코딩 바디를 읽어서 버리고 바디 크기를 리턴하는 함수 (잘못된 형식이면 -1)
+long read_chunked(rio_t *rio)
+{
+  char buf[MAXLINE];
+  long total = 0, size;
+
+  while (1)
+  {
+    if (rio_readlineb(rio, buf, MAXLINE) <= 0)
+      return -1;
+    if ((size = strtol(buf, NULL, 16)) <= 0)
+      break;
+    if (read_body(rio, size) < 0 || rio_readlineb(rio, buf, MAXLINE) <= 0) // chunk 데이터와 뒤따르는 CRLF
+      return -1;
+    total += size;
+  }
+  do // trailer와 마지막 빈 줄
+  {
+    if (rio_readlineb(rio, buf, MAXLINE) <= 0)
+      return -1;
+  } while (strcmp(buf, "\r\n") && strcmp(buf, "\n"));
+  return total;
+}
+
+// 요청 mix에서 가중치에 따라 경로를 고르는 함수
+char *pick_path(unsigned int *seed)
+{
+  int r = rand_r(seed) % mix_weight;
+
+  for (int i = 0; i < mix_cnt; i++)
+    if ((r -= mix[i].weight) < 0)
+      return mix[i].path;
+  return mix[0].path;
+}
+
+// 요청 하나를 보낼 수 있으면 1 (`-n`으로 지정한 요청 수를 모두 시작했으면 0)
+int take_request(void)
+{
+  int ok;
+
+  if (!request_limit)
+    return 1;
+  P(&limit_mutex);
+  if ((ok = requests_taken < request_limit))
+    requests_taken++;
+  V(&limit_mutex);
+  return ok;
+}
+
+long now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// when(us)까지 대기하는 함수
+void sleep_until(long when)
+{
+  long wait = when - now_us();
+  struct timespec ts = {wait / 1000000L, (wait % 1000000L) * 1000};
+
+  if (wait > 0)
+    nanosleep(&ts, NULL);
+}
+
+// `host:port` 형식을 나누는 함수 (포트가 없으면 80)
+void split_hostport(char *spec, char *hostname, char *portnum)
+{
+  char *colon = strrchr(spec, ':');
+
+  if (colon)
+  {
+    snprintf(hostname, MAXLINE, "%.*s", (int)(colon - spec), spec);
+    snprintf(portnum, MAXLINE, "%s", colon + 1);
+  }
+  else
+  {
+    snprintf(hostname, MAXLINE, "%s", spec);
+    strcpy(portnum, "80");
+  }
+}
+
+void hist_record(hist_t *hist, long value)
+{
+  if (value < 0)
+    value = 0;
+  hist->counts[hist_index(value)]++;
+  if (!hist->total || value < hist->min)
+    hist->min = value;
+  if (value > hist->max)
+    hist->max = value;
+  hist->total++;
+  hist->sum += value;
+}
+
+void hist_merge(hist_t *dst, hist_t *src)
+{
+  if (!src->total)
+    return;
+  for (int i = 0; i < HIST_BUCKETS; i++)
+    dst->counts[i] += src->counts[i];
+  if (!dst->total || src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+  dst->total += src->total;
+  dst->sum += src->sum;
+}
+
+// 기록한 값 중 percentile(%) 위치의 값을 리턴하는 함수 (칸의 상한값, 최댓값을 넘지 않음)
+long hist_percentile(hist_t *hist, double percentile)
+{
+  long target = (long)(percentile / 100 * hist->total + 0.5), count = 0;
+
+  if (target < 1)
+    target = 1;
+  for (int i = 0; i < HIST_BUCKETS; i++)
+    if ((count += hist->counts[i]) >= target)
+      return hist_value(i) < hist->max ? hist_value(i) : hist->max;
+  return hist->max;
+}
+
+// HdrHistogram의 백분위 분포 형식(Value, Percentile, TotalCount, 1/(1-Percentile))으로 출력
+// 백분위는 남은 비율을 반씩 줄여가며 찍으므로 꼬리 쪽이 자세히 보임
+void print_distribution(hist_t *hist)
+{
+  long count = 0;
+  double next = 0, step = 10;
+
+  printf("%12s %14s %10s %14s\n\n", "Value(us)", "Percentile", "TotalCount", "1/(1-Percentile)");
+  for (int i = 0; i < HIST_BUCKETS && count < hist->total; i++)
+  {
+    if (!hist->counts[i])
+      continue;
+    count += hist->counts[i];
+    double percentile = 100.0 * count / hist->total;
+    if (percentile < next && count < hist->total)
+      continue;
+    long value = hist_value(i) < hist->max ? hist_value(i) : hist->max;
+    if (count < hist->total)
+      printf("%12ld %14.6f %10ld %14.2f\n", value, percentile / 100, count, 100 / (100 - percentile));
+    else
+    {
+      printf("%12ld %14.6f %10ld %14s\n", value, 1.0, count, "inf");
+      break;
+    }
+    while (next <= percentile) // 다음 출력 위치: 남은 비율의 절반을 5칸으로 나눔
+    {
+      next += step;
+      if (100 - next < step * 5 / 2)
+        step /= 2;
+    }
+  }
+  printf("#[Mean = %.2f, Max = %ld, Total count = %ld]\n", hist->sum / hist->total, hist->max, hist->total);
+}
+
+// 값이 들어갈 칸 번호
+// HIST_SUB_COUNT 미만은 1us 단위, 그 위로는 2배씩 커지는 구간마다 HIST_HALF_COUNT칸 (칸의 폭은 2^shift)
+static int hist_index(long value)
+{
+  int shift = 0;
+
+  if (value < HIST_SUB_COUNT)
+    return value;
+  while ((value >> shift) >= HIST_SUB_COUNT)
+    shift++;
+  if (shift > HIST_SHIFT_MAX)
+    return HIST_BUCKETS - 1;
+  return HIST_SUB_COUNT + (shift - 1) * HIST_HALF_COUNT + (value >> shift) - HIST_HALF_COUNT;
+}
+
+// 칸에 들어가는 가장 큰 값
+static long hist_value(int index)
+{
+  if (index < HIST_SUB_COUNT)
+    return index;
+  int shift = (index - HIST_SUB_COUNT) / HIST_HALF_COUNT + 1;
+  long sub = (index - HIST_SUB_COUNT) % HIST_HALF_COUNT + HIST_HALF_COUNT;
+  return ((sub + 1) << shift) - 1;
+}
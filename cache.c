@@ -6,89 +6,501 @@
 web_object_t *rootp;
 web_object_t *lastp;
 int total_cache_size = 0;
+int default_ttl = 0;
+int default_swr = 0;
+int default_sie = 0;
+
+static sem_t mutex; // 캐시 연결리스트와 negative 캐시를 보호하는 세마포어
+
+// 백그라운드 갱신을 기다리는 stale 객체의 원형 큐
+static web_object_t *refresh_queue[REFRESH_QUEUE_SIZE];
+static int refresh_front = 0, refresh_rear = 0, refresh_cnt = 0;
+static sem_t refresh_items; // 큐에 들어있는 객체 수
+
+// 스레드별 L1 캐시: 가장 최근에 사용한 객체의 참조를 path 해시로 보관 (direct-mapped)
+// 공유 캐시에서 객체가 제거될 때마다 `cache_generation`이 증가하며,
+// 세대가 바뀐 L1 캐시는 다음 조회 때 제거된 객체의 참조만 반환함
+typedef struct
+{
+  unsigned int hash;
+  unsigned int hits; // 마지막으로 공유 캐시의 LRU 순서를 갱신한 뒤의 hit 수
+  web_object_t *web_object;
+} l1_entry_t;
+
+static unsigned long cache_generation = 0;
+static __thread l1_entry_t l1_cache[L1_CACHE_SIZE];
+static __thread unsigned long l1_generation = 0;
+
+// 에러 응답을 캐싱할 상태 코드와 TTL(초) 목록 (`-n status=ttl` 옵션으로 변경 가능)
+typedef struct
+{
+  int status;
+  int ttl;
+} negative_ttl_t;
+
+static negative_ttl_t negative_ttls[16] = {
+    {404, 10},
+    {410, 60},
+    {500, 3},
+    {502, 3},
+    {503, 3},
+    {504, 3},
+};
+static int negative_ttl_cnt = 6;
+static int connect_ttl = 5; // 연결에 실패한 host:port를 기억하는 시간(초)
+
+// 연결에 실패한 host:port 목록 (원형 버퍼)
+typedef struct
+{
+  char hostname[MAXLINE];
+  char port[16];
+  time_t expire;
+} negative_host_t;
+
+static negative_host_t negative_hosts[MAX_NEGATIVE_HOSTS];
+static int negative_host_next = 0;
+
+static void unlink_cache(web_object_t *web_object);
+static void free_object(web_object_t *web_object);
+static unsigned int hash_path(char *path);
+static void move_to_root(web_object_t *web_object);
+static void prune_l1_cache(unsigned long generation);
+
+// 캐시를 초기화하는 함수 (스레드 생성 전에 호출)
+void init_cache(void)
+{
+  rootp = NULL;
+  lastp = NULL;
+  total_cache_size = 0;
+  Sem_init(&mutex, 0, 1);
+  Sem_init(&refresh_items, 0, 0);
+}
 
 // 캐싱된 웹 객체 중에 해당 `path`를 가진 객체를 반환하는 함수
-web_object_t *find_cache(char *path)
+// 반환된 객체는 참조 카운트가 증가된 상태이므로 사용 후 `read_cache` 혹은 `release_cache`를 호출해야 함
+// `state`에는 객체의 신선도(CACHE_FRESH, CACHE_STALE, CACHE_STALE_ERROR)를 저장
+web_object_t *find_cache(char *path, int *state)
 {
-  if (!rootp) // 캐시가 비었으면
-    return NULL;
-  web_object_t *current = rootp;      // 검사를 시작할 노드
-  while (strcmp(current->path, path)) // 현재 검사 중인 노드의 path가 찾는 path와 다르면 반복
-  {
-    if (!current->next) // 현재 검사 중인 노드의 다음 노드가 없으면 NULL 반환
-      return NULL;
+  time_t now = time(NULL);
+
+  P(&mutex);
+  web_object_t *current = rootp; // 검사를 시작할 노드
+  while (current && strcmp(current->path, path))
+    current = current->next; // 다음 노드로 이동
 
-    current = current->next;          // 다음 노드로 이동
-    if (!strcmp(current->path, path)) // path가 같은 노드를 찾았다면 해당 객체 반환
-      return current;
+  *state = CACHE_FRESH;
+  if (current && current->expire && current->expire <= now) // 만료된 객체
+  {
+    if (now < current->expire + current->swr) // 바로 응답하고 백그라운드에서 갱신
+    {
+      *state = CACHE_STALE;
+      if (!current->refreshing && refresh_cnt < REFRESH_QUEUE_SIZE)
+      {
+        current->refreshing = 1;
+        current->refcnt++; // 갱신 스레드가 사용하는 참조
+        refresh_queue[refresh_rear] = current;
+        refresh_rear = (refresh_rear + 1) % REFRESH_QUEUE_SIZE;
+        refresh_cnt++;
+        V(&refresh_items);
+      }
+    }
+    else if (now < current->expire + current->sie) // Server 에러 시에만 응답
+      *state = CACHE_STALE_ERROR;
+    else // 더 이상 사용할 수 없는 객체는 제거하고 miss 처리
+    {
+      unlink_cache(current);
+      if (!current->refcnt)
+        free_object(current);
+      current = NULL;
+    }
   }
+
+  if (current)
+    current->refcnt++;
+  V(&mutex);
   return current;
 }
 
 // `web_object`에 저장된 response를 Client에 전송하는 함수
 void send_cache(web_object_t *web_object, int clientfd)
 {
-  // 1️⃣ Response Header 생성 및 전송
+  // 1️⃣ Response Header 생성
   char buf[MAXLINE];
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");                                           // 상태 코드
-  sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);                            // 서버 이름
-  sprintf(buf, "%sConnection: close\r\n", buf);                                  // 연결 방식
-  sprintf(buf, "%sContent-length: %d\r\n\r\n", buf, web_object->content_length); // 컨텐츠 길이
-  Rio_writen(clientfd, buf, strlen(buf));
+  struct iovec iov[2];
+  int n = 0;
+  n += sprintf(buf + n, "HTTP/1.0 %d %s\r\n", web_object->status, web_object->status_msg); // 상태 코드
+  n += sprintf(buf + n, "Server: Tiny Web Server\r\n");                                     // 서버 이름
+  n += sprintf(buf + n, "Connection: close\r\n");                                           // 연결 방식
+  n += sprintf(buf + n, "Content-length: %d\r\n\r\n", web_object->content_length);          // 컨텐츠 길이
 
-  // 2️⃣ 캐싱된 Response Body 전송
-  Rio_writen(clientfd, web_object->response_ptr, web_object->content_length);
+  // 2️⃣ Response Header와 캐싱된 Response Body를 한 번에 전송
+  iov[0].iov_base = buf;
+  iov[0].iov_len = n;
+  iov[1].iov_base = web_object->response_ptr;
+  iov[1].iov_len = web_object->content_length;
+  rio_writev(clientfd, iov, 2);
 }
 
-// 사용한 `web_object`를 캐시 연결리스트의 root로 갱신하는 함수
+// 사용한 `web_object`를 캐시 연결리스트의 root로 갱신하고 참조를 반환하는 함수
 void read_cache(web_object_t *web_object)
 {
-  if (web_object == rootp) // 현재 노드가 이미 root면 변경 없이 종료
+  P(&mutex);
+  web_object->refcnt--;
+  if (web_object->evicted) // 전송 중에 캐시에서 제거된 객체
+  {
+    if (!web_object->refcnt)
+      free_object(web_object);
+    V(&mutex);
+    return;
+  }
+
+  move_to_root(web_object);
+  V(&mutex);
+}
+
+// 현재 노드를 캐시 연결리스트의 root로 옮기는 함수 (mutex를 잡은 상태에서 호출)
+static void move_to_root(web_object_t *web_object)
+{
+  if (web_object == rootp) // 현재 노드가 이미 root면 변경 없음
     return;
 
   // 1️⃣ 현재 노드와 이전 & 다음 노드의 연결 끊기
-  if (web_object->next) // '이전 & 다음 노드'가 모두 있는 경우
-  {
-    // 이전 노드와 다음 노드를 이어줌
-    web_object_t *prev_objtect = web_object->prev;
-    web_object_t *next_objtect = web_object->next;
-    if (prev_objtect)
-      web_object->prev->next = next_objtect;
-    web_object->next->prev = prev_objtect;
-  }
-  else // '다음 노드'가 없는 경우 (현재 노드가 마지막 노드인 경우)
-  {
-    web_object->prev->next = NULL; // 이전 노드와 현재 노드의 연결을 끊어줌
-  }
+  web_object->prev->next = web_object->next;
+  if (web_object->next)
+    web_object->next->prev = web_object->prev;
+  else // 현재 노드가 마지막 노드인 경우
+    lastp = web_object->prev;
 
   // 2️⃣ 현재 노드를 root로 변경
+  web_object->prev = NULL;
   web_object->next = rootp; // root였던 노드는 현재 노드의 다음 노드가 됨
+  rootp->prev = web_object;
   rootp = web_object;
 }
 
+// LRU 순서는 그대로 두고 `find_cache`로 얻은 참조만 반환하는 함수
+void release_cache(web_object_t *web_object)
+{
+  P(&mutex);
+  if (!--web_object->refcnt && web_object->evicted)
+    free_object(web_object);
+  V(&mutex);
+}
+
 // 인자로 전달된 `web_object`를 캐시 연결리스트에 추가하는 함수
+// 같은 `path`의 이전 객체(stale 객체 등)는 새 객체로 교체됨
 void write_cache(web_object_t *web_object)
 {
+  P(&mutex);
+  web_object_t *current = rootp;
+  while (current)
+  {
+    web_object_t *next = current->next;
+    if (!strcmp(current->path, web_object->path))
+    {
+      unlink_cache(current);
+      if (!current->refcnt)
+        free_object(current);
+    }
+    current = next;
+  }
+
   // total_cache_size에 현재 객체의 크기 추가
   total_cache_size += web_object->content_length;
 
   // 최대 총 캐시 크기를 초과한 경우 -> 사용한지 가장 오래된 객체부터 제거
-  while (total_cache_size > MAX_CACHE_SIZE)
+  while (total_cache_size > MAX_CACHE_SIZE && lastp)
   {
-    total_cache_size -= lastp->content_length;
-    lastp = lastp->prev; // 마지막 노드를 마지막의 이전 노드로 변경
-    free(lastp->next);   // 제거한 노드의 메모리 반환
-    lastp->next = NULL;
+    web_object_t *victim = lastp;
+    unlink_cache(victim);
+    if (!victim->refcnt) // 전송 중인 객체는 마지막 참조가 반환될 때 해제
+      free_object(victim);
   }
 
-  if (!rootp) // 캐시 연결리스트가 빈 경우 lastp를 현재 객체로 지정
-    lastp = web_object;
-
   // 현재 객체를 루트로 지정
+  web_object->prev = NULL;
+  web_object->next = rootp;
   if (rootp)
-  {
-    web_object->next = rootp;
     rootp->prev = web_object;
-  }
+  else // 캐시 연결리스트가 빈 경우 lastp를 현재 객체로 지정
+    lastp = web_object;
   rootp = web_object;
-}
\ No newline at end of file
+  V(&mutex);
+}
+
+// `web_object`를 캐시 연결리스트에서 떼어내는 함수 (mutex를 잡은 상태에서 호출)
+static void unlink_cache(web_object_t *web_object)
+{
+  if (web_object->prev)
+    web_object->prev->next = web_object->next;
+  else
+    rootp = web_object->next;
+  if (web_object->next)
+    web_object->next->prev = web_object->prev;
+  else
+    lastp = web_object->prev;
+
+  web_object->prev = web_object->next = NULL;
+  __atomic_store_n(&web_object->evicted, 1, __ATOMIC_RELAXED);
+  total_cache_size -= web_object->content_length;
+  __atomic_add_fetch(&cache_generation, 1, __ATOMIC_RELEASE); // 각 L1 캐시가 제거된 객체를 찾아 반환하도록 알림
+}
+
+static void free_object(web_object_t *web_object)
+{
+  free(web_object->response_ptr);
+  free(web_object);
+}
+
+// FNV-1a 해시
+static unsigned int hash_path(char *path)
+{
+  unsigned int hash = 2166136261u;
+  while (*path)
+    hash = (hash ^ (unsigned char)*path++) * 16777619u;
+  return hash;
+}
+
+// 현재 스레드의 L1 캐시에서 공유 캐시에서 제거된 객체의 참조만 반환하고 `generation` 세대로 갱신하는 함수
+// 다른 엔트리는 그대로 두므로 한 객체가 제거되어도 L1 캐시 전체가 비워지지 않음
+static void prune_l1_cache(unsigned long generation)
+{
+  int locked = 0;
+  for (int i = 0; i < L1_CACHE_SIZE; i++)
+  {
+    web_object_t *web_object = l1_cache[i].web_object;
+    if (!web_object || !__atomic_load_n(&web_object->evicted, __ATOMIC_RELAXED))
+      continue;
+    if (!locked) // 반환할 참조가 있을 때만 mutex를 잡음
+    {
+      P(&mutex);
+      locked = 1;
+    }
+    if (!--web_object->refcnt)
+      free_object(web_object);
+    l1_cache[i].web_object = NULL;
+  }
+  if (locked)
+    V(&mutex);
+  l1_generation = generation;
+}
+
+// 현재 스레드의 L1 캐시가 가진 참조를 모두 반환하는 함수
+// 대기 상태로 들어가는 worker가 호출해 캐시에서 제거된 객체를 계속 붙잡고 있지 않도록 함
+void flush_l1_cache(void)
+{
+  P(&mutex);
+  for (int i = 0; i < L1_CACHE_SIZE; i++)
+  {
+    web_object_t *web_object = l1_cache[i].web_object;
+    if (web_object && !--web_object->refcnt && web_object->evicted)
+      free_object(web_object);
+    l1_cache[i].web_object = NULL;
+  }
+  V(&mutex);
+}
+
+// 현재 스레드의 L1 캐시에서 신선한 객체를 찾는 함수 (hit가 `L1_TOUCH_INTERVAL`번 쌓일 때만 mutex를 잡음)
+// 반환된 객체는 L1 캐시가 참조를 갖고 있으므로 `read_cache`를 호출하지 않음
+web_object_t *find_l1_cache(char *path)
+{
+  unsigned long generation = __atomic_load_n(&cache_generation, __ATOMIC_ACQUIRE);
+  if (generation != l1_generation) // 공유 캐시에서 객체가 제거된 뒤라면 제거된 객체를 L1 캐시에서 정리
+    prune_l1_cache(generation);
+
+  unsigned int hash = hash_path(path);
+  l1_entry_t *entry = &l1_cache[hash % L1_CACHE_SIZE];
+  web_object_t *web_object = entry->web_object;
+  if (!web_object || entry->hash != hash || strcmp(web_object->path, path))
+    return NULL;
+  if (web_object->expire && web_object->expire <= time(NULL)) // 만료된 객체는 공유 캐시에서 처리
+    return NULL;
+
+  // L1 캐시 hit는 공유 캐시를 거치지 않으므로, 가끔씩 LRU 순서를 갱신해 자주 쓰이는 객체가 먼저 제거되지 않게 함
+  if (++entry->hits >= L1_TOUCH_INTERVAL)
+  {
+    entry->hits = 0;
+    P(&mutex);
+    if (!web_object->evicted)
+      move_to_root(web_object);
+    V(&mutex);
+  }
+  return web_object;
+}
+
+// 공유 캐시에서 찾은 신선한 객체를 현재 스레드의 L1 캐시에 넣는 함수
+void write_l1_cache(web_object_t *web_object)
+{
+  unsigned long generation = __atomic_load_n(&cache_generation, __ATOMIC_ACQUIRE);
+  if (generation != l1_generation)
+    prune_l1_cache(generation);
+
+  unsigned int hash = hash_path(web_object->path);
+  l1_entry_t *entry = &l1_cache[hash % L1_CACHE_SIZE];
+
+  P(&mutex);
+  if (entry->web_object && !--entry->web_object->refcnt && entry->web_object->evicted)
+    free_object(entry->web_object);
+  entry->web_object = NULL;
+  if (!web_object->evicted) // 이미 제거된 객체는 넣지 않음
+  {
+    web_object->refcnt++;
+    entry->hash = hash;
+    entry->hits = 0;
+    entry->web_object = web_object;
+  }
+  V(&mutex);
+}
+
+// 백그라운드 갱신이 필요한 stale 객체를 꺼내는 함수 (큐가 빌 때는 대기)
+web_object_t *dequeue_refresh(void)
+{
+  P(&refresh_items);
+  P(&mutex);
+  web_object_t *web_object = refresh_queue[refresh_front];
+  refresh_front = (refresh_front + 1) % REFRESH_QUEUE_SIZE;
+  refresh_cnt--;
+  V(&mutex);
+  return web_object;
+}
+
+// 백그라운드 갱신을 마친 stale 객체의 참조를 반환하는 함수
+// 갱신에 실패해 아직 캐시에 남아있다면 다음 요청에서 다시 갱신을 시도함
+void finish_refresh(web_object_t *web_object)
+{
+  P(&mutex);
+  web_object->refreshing = 0;
+  V(&mutex);
+  release_cache(web_object);
+}
+
+void init_cache_control(cache_control_t *cc)
+{
+  cc->max_age = cc->swr = cc->sie = -1;
+  cc->no_store = cc->has_length = 0;
+}
+
+// `Cache-Control: max-age=60, stale-while-revalidate=30` 형태의 헤더 라인을 파싱하는 함수
+void parse_cache_control(char *buf, cache_control_t *cc)
+{
+  char *ptr;
+
+  if ((ptr = strstr(buf, "s-maxage=")) || (ptr = strstr(buf, "max-age=")))
+    cc->max_age = atoi(strchr(ptr, '=') + 1);
+  if ((ptr = strstr(buf, "stale-while-revalidate=")))
+    cc->swr = atoi(strchr(ptr, '=') + 1);
+  if ((ptr = strstr(buf, "stale-if-error=")))
+    cc->sie = atoi(strchr(ptr, '=') + 1);
+  if (strstr(buf, "no-store") || strstr(buf, "private"))
+    cc->no_store = 1;
+}
+
+// Response Header만으로 캐싱할 수 있는 응답인지 확인하는 함수
+// (Body를 받기 전에 호출해 캐시에 넣을 Body만 캐시가 소유할 메모리로 받도록 함)
+int is_cacheable(int status, int content_length, cache_control_t *cc)
+{
+  return (status == 200 || negative_ttl(status) > 0) && cc->has_length && content_length >= 0 && content_length <= MAX_OBJECT_SIZE &&
+         !cc->no_store;
+}
+
+// Server의 응답으로 캐시에 넣을 `web_object`를 생성하는 함수
+// 캐싱할 수 없는 응답이면 NULL을 반환하며, 이 경우 `response_ptr`는 호출한 쪽에서 해제해야 함
+web_object_t *create_object(char *path, char *host, char *port, int status, char *status_msg,
+                            char *response_ptr, int content_length, cache_control_t *cc)
+{
+  int ttl = status == 200 ? default_ttl : negative_ttl(status);
+
+  if (!is_cacheable(status, content_length, cc))
+    return NULL;
+
+  web_object_t *web_object = (web_object_t *)calloc(1, sizeof(web_object_t));
+  strcpy(web_object->path, path);
+  snprintf(web_object->host, sizeof(web_object->host), "%s", host);
+  snprintf(web_object->port, sizeof(web_object->port), "%s", port);
+  web_object->status = status;
+  snprintf(web_object->status_msg, sizeof(web_object->status_msg), "%s", status_msg);
+  web_object->response_ptr = response_ptr;
+  web_object->content_length = content_length;
+
+  // 에러 응답은 짧은 TTL 후 만료되고, stale 상태로 사용하지 않음
+  if (status == 200)
+  {
+    if (cc->max_age >= 0)
+      ttl = cc->max_age;
+    web_object->swr = cc->swr >= 0 ? cc->swr : default_swr;
+    web_object->sie = cc->sie >= 0 ? cc->sie : default_sie;
+  }
+  if (ttl > 0 || cc->max_age == 0) // `max-age=0`이면 바로 만료
+    web_object->expire = time(NULL) + ttl;
+  return web_object;
+}
+
+// 에러 상태 코드의 negative 캐시 TTL(초)을 반환하는 함수 (캐싱하지 않으면 0)
+int negative_ttl(int status)
+{
+  for (int i = 0; i < negative_ttl_cnt; i++)
+    if (negative_ttls[i].status == status)
+      return negative_ttls[i].ttl;
+  return 0;
+}
+
+// `status=ttl` 혹은 `connect=ttl` 형식의 설정을 반영하는 함수 (잘못된 형식이면 -1 반환)
+int set_negative_ttl(char *spec)
+{
+  char *eq = strchr(spec, '=');
+  if (!eq)
+    return -1;
+  int ttl = atoi(eq + 1);
+
+  if (!strncmp(spec, "connect=", 8))
+  {
+    connect_ttl = ttl;
+    return 0;
+  }
+
+  int status = atoi(spec);
+  if (status < 400 || status > 599)
+    return -1;
+  for (int i = 0; i < negative_ttl_cnt; i++)
+    if (negative_ttls[i].status == status)
+    {
+      negative_ttls[i].ttl = ttl;
+      return 0;
+    }
+  if (negative_ttl_cnt == sizeof(negative_ttls) / sizeof(negative_ttls[0]))
+    return -1;
+  negative_ttls[negative_ttl_cnt].status = status;
+  negative_ttls[negative_ttl_cnt++].ttl = ttl;
+  return 0;
+}
+
+// 최근에 연결에 실패한 host:port인지 확인하는 함수
+int find_negative_host(char *hostname, char *port)
+{
+  int found = 0;
+  time_t now = time(NULL);
+
+  P(&mutex);
+  for (int i = 0; i < MAX_NEGATIVE_HOSTS && !found; i++)
+  {
+    negative_host_t *host = &negative_hosts[i];
+    found = host->expire > now && !strcmp(host->hostname, hostname) && !strcmp(host->port, port);
+  }
+  V(&mutex);
+  return found;
+}
+
+// 연결에 실패한 host:port를 기록하는 함수 (가장 오래된 기록을 덮어씀)
+void write_negative_host(char *hostname, char *port)
+{
+  if (connect_ttl <= 0)
+    return;
+
+  P(&mutex);
+  negative_host_t *host = &negative_hosts[negative_host_next];
+  snprintf(host->hostname, MAXLINE, "%s", hostname);
+  snprintf(host->port, sizeof(host->port), "%s", port);
+  host->expire = time(NULL) + connect_ttl;
+  negative_host_next = (negative_host_next + 1) % MAX_NEGATIVE_HOSTS;
+  V(&mutex);
+}
@@ -1,23 +1,76 @@
 #include <stdio.h>
+#include <time.h>
 
 #include "csapp.h"
 
 typedef struct web_object_t
 {
   char path[MAXLINE];
+  char host[256];      // 백그라운드 갱신 시 요청을 보낼 Server
+  char port[16];
+  int status;          // 응답 상태 코드 (200이 아니면 negative 캐시 객체)
+  char status_msg[64]; // 상태 메시지 (ex. `Not found`)
+  time_t expire;       // 만료 시각 (0이면 만료 없음)
+  int swr;             // 만료 후 바로 응답하면서 백그라운드로 갱신할 수 있는 시간(초) (stale-while-revalidate)
+  int sie;             // 만료 후 Server 에러 시 대신 응답할 수 있는 시간(초) (stale-if-error)
+  int refreshing;      // 백그라운드 갱신이 진행 중이면 1
   int content_length;
   char *response_ptr;
+  int refcnt;  // 현재 이 객체를 전송 중인 스레드 수
+  int evicted; // 캐시에서 제거되었지만 아직 전송 중인 경우 1
   struct web_object_t *prev, *next;
 } web_object_t;
 
-web_object_t *find_cache(char *path);
+// Response의 `Cache-Control` 헤더에서 읽은 값 (-1이면 지정되지 않음)과 캐싱 여부를 정하는 헤더 정보
+typedef struct
+{
+  int max_age;
+  int swr;
+  int sie;
+  int no_store;
+  int has_length; // Content-length 헤더가 있으면 1 (없으면 chunked 혹은 연결 종료로 끝나는 Body이므로 캐싱하지 않음)
+} cache_control_t;
+
+// `find_cache`가 반환한 객체의 상태
+#define CACHE_FRESH 0       // 신선한 객체: 그대로 응답
+#define CACHE_STALE 1       // stale-while-revalidate 구간: 바로 응답하고 백그라운드에서 갱신
+#define CACHE_STALE_ERROR 2 // stale-if-error 구간: Server 요청이 실패한 경우에만 응답
+
+void init_cache(void);
+web_object_t *find_cache(char *path, int *state);
 void send_cache(web_object_t *web_object, int clientfd);
 void read_cache(web_object_t *web_object);
+void release_cache(web_object_t *web_object);
 void write_cache(web_object_t *web_object);
+web_object_t *find_l1_cache(char *path);
+void write_l1_cache(web_object_t *web_object);
+void flush_l1_cache(void);
+
+void init_cache_control(cache_control_t *cc);
+void parse_cache_control(char *buf, cache_control_t *cc);
+int is_cacheable(int status, int content_length, cache_control_t *cc);
+web_object_t *create_object(char *path, char *host, char *port, int status, char *status_msg,
+                            char *response_ptr, int content_length, cache_control_t *cc);
+
+web_object_t *dequeue_refresh(void);
+void finish_refresh(web_object_t *web_object);
+
+int negative_ttl(int status);
+int set_negative_ttl(char *spec);
+int find_negative_host(char *hostname, char *port);
+void write_negative_host(char *hostname, char *port);
 
 extern web_object_t *rootp;  // 캐시 연결리스트의 root 객체
 extern web_object_t *lastp;  // 캐시 연결리스트의 마지막 객체
 extern int total_cache_size; // 캐싱된 객체 크기의 총합
+extern int default_ttl;      // `max-age`가 없는 응답의 신선 유지 시간(초) (0이면 만료 없음)
+extern int default_swr;      // `stale-while-revalidate`가 없는 응답에 적용할 값(초)
+extern int default_sie;      // `stale-if-error`가 없는 응답에 적용할 값(초)
 
 #define MAX_CACHE_SIZE 1049000
-#define MAX_OBJECT_SIZE 102400
\ No newline at end of file
+#define MAX_OBJECT_SIZE 102400
+#define MAX_NEGATIVE_HOSTS 64 // 연결 실패를 기억할 host:port 최대 개수
+#define REFRESH_QUEUE_SIZE 16 // 백그라운드 갱신 대기열 크기
+#define REFRESH_THREADS 2     // 백그라운드 갱신 스레드 수
+#define L1_CACHE_SIZE 64      // 스레드별 L1 캐시 엔트리 수
+#define L1_TOUCH_INTERVAL 16  // L1 캐시 hit가 이 횟수만큼 쌓이면 공유 캐시의 LRU 순서도 갱신
@@ -792,20 +792,50 @@ ssize_t rio_writen(int fd, void *usrbuf, size_t n)
 }
 /* $end rio_writen */
 
+/*
+ * rio_writev - Robustly write an iovec array with as few writev()
+ *    calls as possible (unbuffered). Partial writes advance through
+ *    the array, so the iovecs are modified.
+ */
+/* $begin rio_writev */
+ssize_t rio_writev(int fd, struct iovec *iov, int iovcnt) 
+{
+    size_t total = 0;
+    ssize_t nwritten;
+
+    while (iovcnt > 0) {
+	if ((nwritten = writev(fd, iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX)) <= 0) {
+	    if (errno == EINTR)  /* Interrupted by sig handler return */
+		nwritten = 0;    /* and call writev() again */
+	    else
+		return -1;       /* errno set by writev() */
+	}
+	total += nwritten;
+
+	/* Skip the iovecs that were written completely */
+	while (iovcnt > 0 && nwritten >= iov->iov_len) {
+	    nwritten -= iov->iov_len;
+	    iov++;
+	    iovcnt--;
+	}
+	if (iovcnt > 0) {
+	    iov->iov_base = (char *)iov->iov_base + nwritten;
+	    iov->iov_len -= nwritten;
+	}
+    }
+    return total;
+}
+/* $end rio_writev */
+
 
 /* 
- * rio_read - This is a wrapper for the Unix read() function that
- *    transfers min(n, rio_cnt) bytes from an internal buffer to a user
- *    buffer, where n is the number of bytes requested by the user and
- *    rio_cnt is the number of unread bytes in the internal buffer. On
- *    entry, rio_read() refills the internal buffer via a call to
- *    read() if the internal buffer is empty.
+ * rio_fill - Refill the internal buffer via a call to read() if it
+ *    is empty. Returns the number of unread bytes in the buffer, 0 on
+ *    EOF, or -1 on error.
  */
-/* $begin rio_read */
-static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
+/* $begin rio_fill */
+static ssize_t rio_fill(rio_t *rp)
 {
-    int cnt;
-
     while (rp->rio_cnt <= 0) {  /* Refill if buf is empty */
 	rp->rio_cnt = read(rp->rio_fd, rp->rio_buf, 
 			   sizeof(rp->rio_buf));
@@ -818,6 +848,25 @@ static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
 	else 
 	    rp->rio_bufptr = rp->rio_buf; /* Reset buffer ptr */
     }
+    return rp->rio_cnt;
+}
+/* $end rio_fill */
+
+/* 
+ * rio_read - This is a wrapper for the Unix read() function that
+ *    transfers min(n, rio_cnt) bytes from an internal buffer to a user
+ *    buffer, where n is the number of bytes requested by the user and
+ *    rio_cnt is the number of unread bytes in the internal buffer. On
+ *    entry, rio_read() refills the internal buffer via a call to
+ *    read() if the internal buffer is empty.
+ */
+/* $begin rio_read */
+static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
+{
+    int cnt;
+
+    if ((cnt = rio_fill(rp)) <= 0)
+	return cnt;
 
     /* Copy min(n, rp->rio_cnt) bytes from internal buf to user buf */
     cnt = n;          
@@ -865,34 +914,92 @@ ssize_t rio_readnb(rio_t *rp, void *usrbuf, size_t n)
 /* $end rio_readnb */
 
 /* 
- * rio_readlineb - Robustly read a text line (buffered)
+ * rio_readlineb - Robustly read a text line (buffered). Each refill
+ *    of the internal buffer is scanned for '\n' with memchr() (which
+ *    libc implements with SSE2/AVX2) and copied out in one memcpy().
  */
 /* $begin rio_readlineb */
 ssize_t rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen) 
 {
-    int n, rc;
-    char c, *bufp = usrbuf;
-
-    for (n = 1; n < maxlen; n++) { 
-        if ((rc = rio_read(rp, &c, 1)) == 1) {
-	    *bufp++ = c;
-	    if (c == '\n') {
-                n++;
-     		break;
-            }
-	} else if (rc == 0) {
-	    if (n == 1)
-		return 0; /* EOF, no data read */
-	    else
-		break;    /* EOF, some data was read */
-	} else
+    size_t n = 0, cnt;
+    ssize_t rc;
+    char *nl = NULL, *bufp = usrbuf;
+
+    if (maxlen == 0)
+	return 0;
+    while (!nl && n < maxlen - 1) {
+	if ((rc = rio_fill(rp)) < 0)
 	    return -1;	  /* Error */
+	else if (rc == 0)
+	    break;	  /* EOF */
+
+	/* Copy up to and including the next '\n' in the internal buf */
+	cnt = maxlen - 1 - n;
+	if (rp->rio_cnt < cnt)
+	    cnt = rp->rio_cnt;
+	if ((nl = memchr(rp->rio_bufptr, '\n', cnt)))
+	    cnt = nl - rp->rio_bufptr + 1;
+	memcpy(bufp + n, rp->rio_bufptr, cnt);
+	rp->rio_bufptr += cnt;
+	rp->rio_cnt -= cnt;
+	n += cnt;
     }
-    *bufp = 0;
-    return n-1;
+    bufp[n] = 0;
+    return n;
 }
 /* $end rio_readlineb */
 
+/* 
+ * rio_readlinep - Read a text line (buffered) without copying it.
+ *    *linep is set to the line inside the internal buffer, which stays
+ *    valid until the next call on rp. A line that straddles the end of
+ *    the buffer is moved to its start before refilling. Returns the
+ *    line length including the '\n' (at most RIO_BUFSIZE for longer
+ *    lines, or the partial line at EOF), 0 on EOF, or -1 on error.
+ */
+/* $begin rio_readlinep */
+ssize_t rio_readlinep(rio_t *rp, char **linep)
+{
+    ssize_t rc;
+    size_t scanned = 0;
+    char *nl;
+
+    if ((rc = rio_fill(rp)) <= 0)
+	return rc;
+    while (!(nl = memchr(rp->rio_bufptr + scanned, '\n', rp->rio_cnt - scanned))) {
+	scanned = rp->rio_cnt;
+	if (rp->rio_cnt == sizeof(rp->rio_buf)) { /* Line fills the whole buf */
+	    nl = rp->rio_bufptr + rp->rio_cnt - 1;
+	    break;
+	}
+
+	/* Move the partial line to the start of buf and append to it */
+	if (rp->rio_bufptr != rp->rio_buf) {
+	    memmove(rp->rio_buf, rp->rio_bufptr, rp->rio_cnt);
+	    rp->rio_bufptr = rp->rio_buf;
+	}
+	rc = read(rp->rio_fd, rp->rio_buf + rp->rio_cnt, 
+		  sizeof(rp->rio_buf) - rp->rio_cnt);
+	if (rc < 0) {
+	    if (errno != EINTR) /* Interrupted by sig handler return */
+		return -1;
+	}
+	else if (rc == 0) {     /* EOF, return the partial line */
+	    nl = rp->rio_bufptr + rp->rio_cnt - 1;
+	    break;
+	}
+	else
+	    rp->rio_cnt += rc;
+    }
+
+    *linep = rp->rio_bufptr;
+    rc = nl - rp->rio_bufptr + 1;
+    rp->rio_bufptr += rc;
+    rp->rio_cnt -= rc;
+    return rc;
+}
+/* $end rio_readlinep */
+
 /**********************************
  * Wrappers for robust I/O routines
  **********************************/
@@ -911,6 +1018,12 @@ void Rio_writen(int fd, void *usrbuf, size_t n)
 	unix_error("Rio_writen error");
 }
 
+void Rio_writev(int fd, struct iovec *iov, int iovcnt) 
+{
+    if (rio_writev(fd, iov, iovcnt) < 0)
+	unix_error("Rio_writev error");
+}
+
 void Rio_readinitb(rio_t *rp, int fd)
 {
     rio_readinitb(rp, fd);
@@ -934,6 +1047,15 @@ ssize_t Rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen)
     return rc;
 } 
 
+ssize_t Rio_readlinep(rio_t *rp, char **linep) 
+{
+    ssize_t rc;
+
+    if ((rc = rio_readlinep(rp, linep)) < 0)
+	unix_error("Rio_readlinep error");
+    return rc;
+} 
+
 /******************************** 
  * Client/server helper functions
  ********************************/
@@ -0,0 +1,212 @@
+#include <stdio.h>
+
+#include "csapp.h"
+#include "http_parser.h"
+
+// 헤더 표: 헤더 이름을 소문자로 바꾼 FNV-1a 해시의 상위 HDR_TABLE_BITS 비트가 슬롯 번호 (perfect hash)
+// 등록된 헤더끼리 슬롯이 겹치지 않도록 고른 seed를 사용하므로, 헤더를 추가할 때는 겹치지 않는 seed를 다시 찾아 슬롯 번호를 갱신해야 함
+// (슬롯 번호가 틀리면 시작할 때 `http_check_header_table`이 종료시킴)
+#define HDR_HASH_SEED 242
+#define HDR_TABLE_BITS 5
+#define HDR(name, id, request_action, response_action) {name, sizeof(name) - 1, id, request_action, response_action}
+
+static const http_header_info_t header_table[1 << HDR_TABLE_BITS] = {
+    [2] = HDR("Host", HDR_HOST, HDR_CAPTURE, HDR_FORWARD),
+    [3] = HDR("Proxy-Connection", HDR_PROXY_CONNECTION, HDR_REWRITE, HDR_DROP),
+    [6] = HDR("Content-Encoding", HDR_CONTENT_ENCODING, HDR_FORWARD, HDR_CAPTURE),
+    [7] = HDR("Last-Modified", HDR_LAST_MODIFIED, HDR_FORWARD, HDR_FORWARD),
+    [9] = HDR("Trailer", HDR_TRAILER, HDR_DROP, HDR_DROP),
+    [11] = HDR("Transfer-Encoding", HDR_TRANSFER_ENCODING, HDR_DROP, HDR_FORWARD),
+    [14] = HDR("ETag", HDR_ETAG, HDR_FORWARD, HDR_FORWARD),
+    [15] = HDR("Content-Length", HDR_CONTENT_LENGTH, HDR_FORWARD, HDR_CAPTURE),
+    [16] = HDR("Proxy-Authorization", HDR_PROXY_AUTHORIZATION, HDR_DROP, HDR_DROP),
+    [17] = HDR("TE", HDR_TE, HDR_DROP, HDR_DROP),
+    [18] = HDR("User-Agent", HDR_USER_AGENT, HDR_REWRITE, HDR_FORWARD),
+    [19] = HDR("Upgrade", HDR_UPGRADE, HDR_DROP, HDR_DROP),
+    [21] = HDR("Keep-Alive", HDR_KEEP_ALIVE, HDR_DROP, HDR_DROP),
+    [22] = HDR("Proxy-Authenticate", HDR_PROXY_AUTHENTICATE, HDR_DROP, HDR_DROP),
+    [24] = HDR("Content-Type", HDR_CONTENT_TYPE, HDR_FORWARD, HDR_CAPTURE),
+    [26] = HDR("Connection", HDR_CONNECTION, HDR_REWRITE, HDR_REWRITE),
+    [27] = HDR("Expires", HDR_EXPIRES, HDR_FORWARD, HDR_FORWARD),
+    [28] = HDR("Cache-Control", HDR_CACHE_CONTROL, HDR_FORWARD, HDR_CAPTURE),
+};
+static const http_header_info_t unknown_header = HDR("", HDR_UNKNOWN, HDR_FORWARD, HDR_FORWARD);
+
+static char *find_block_end(char *buf, int len, http_request_t *request);
+static char *next_token(char *ptr, char *end, http_slice_t *slice);
+
+// 헤더 표의 모든 헤더가 자기 슬롯에서 찾아지는지 확인하는 함수 (슬롯 번호나 seed가 틀리면 종료)
+void http_check_header_table(void)
+{
+  int found[HDR_COUNT] = {0};
+  char msg[MAXLINE];
+
+  for (int i = 0; i < (1 << HDR_TABLE_BITS); i++)
+  {
+    const http_header_info_t *info = &header_table[i];
+    if (!info->name)
+      continue;
+    if (http_lookup_header(info->name, info->len) != info)
+    {
+      snprintf(msg, MAXLINE, "header_table: %s is not in its hash slot (slot %d)", info->name, i);
+      app_error(msg);
+    }
+    found[info->id]++;
+  }
+  for (int id = HDR_UNKNOWN + 1; id < HDR_COUNT; id++)
+    if (found[id] != 1)
+    {
+      snprintf(msg, MAXLINE, "header_table: header id %d is registered %d times", id, found[id]);
+      app_error(msg);
+    }
+}
+
+void http_init_request(http_request_t *request)
+{
+  memset(request, 0, sizeof(http_request_t));
+}
+
+// `buf`에 쌓인 `len` 바이트에서 요청 라인과 헤더 블록 전체를 한 번에 파싱하는 함수
+// 반환 값: 헤더 블록 전체의 길이, 아직 빈 줄을 받지 못했으면 HTTP_INCOMPLETE, 형식이 잘못되었으면 HTTP_BAD_REQUEST
+// 데이터를 더 받은 뒤 같은 `request`로 다시 호출하면 이미 검사한 부분은 건너뛰고 빈 줄을 찾음
+int http_parse_request(char *buf, int len, http_request_t *request)
+{
+  char *ptr = buf, *end, *line_end;
+
+  if (!(end = find_block_end(buf, len, request)))
+    return HTTP_INCOMPLETE;
+
+  // 1️⃣ 요청 라인: `method uri version` (앞에 오는 빈 줄은 무시)
+  while (ptr < end && (*ptr == '\r' || *ptr == '\n'))
+    ptr++;
+  line_end = memchr(ptr, '\n', end - ptr);
+  ptr = next_token(ptr, line_end, &request->method);
+  ptr = next_token(ptr, line_end, &request->uri);
+  ptr = next_token(ptr, line_end, &request->version);
+  if (!request->method.len || !request->uri.len || ptr != line_end)
+    return HTTP_BAD_REQUEST;
+
+  // 2️⃣ 헤더: `name: value` (빈 줄이 나오면 종료)
+  request->header_cnt = 0;
+  for (ptr = line_end + 1; ptr < end; ptr = line_end + 1)
+  {
+    line_end = memchr(ptr, '\n', end - ptr + 1);
+    char *value_end = line_end > ptr && line_end[-1] == '\r' ? line_end - 1 : line_end;
+    if (value_end == ptr) // 빈 줄
+      break;
+
+    char *colon = memchr(ptr, ':', value_end - ptr);
+    if (!colon || colon == ptr || isspace((unsigned char)*ptr) || request->header_cnt == HTTP_MAX_HEADERS)
+      return HTTP_BAD_REQUEST; // `:`이 없거나, 이름이 비었거나, obs-fold 줄이거나, 헤더가 너무 많음
+    http_header_t *header = &request->headers[request->header_cnt++];
+    header->name.ptr = ptr;
+    header->name.len = colon - ptr;
+    if (isspace((unsigned char)colon[-1])) // 이름과 `:` 사이의 공백은 허용하지 않음
+      return HTTP_BAD_REQUEST;
+
+    // 값의 앞뒤 공백 제거
+    for (ptr = colon + 1; ptr < value_end && (*ptr == ' ' || *ptr == '\t'); ptr++)
+      ;
+    while (value_end > ptr && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+      value_end--;
+    header->value.ptr = ptr;
+    header->value.len = value_end - ptr;
+  }
+  return end - buf + 1;
+}
+
+// 헤더 블록의 마지막 `\n`을 찾는 함수 (`\r\n\r\n` 혹은 `\n\n`)
+// 이전 호출에서 검사한 부분은 `request->scanned`부터 이어서 검사
+static char *find_block_end(char *buf, int len, http_request_t *request)
+{
+  char *ptr = buf, *end = buf + len;
+
+  while (ptr < end && (*ptr == '\r' || *ptr == '\n')) // 요청 라인 앞의 빈 줄은 끝이 아님
+    ptr++;
+  if (ptr < buf + request->scanned)
+    ptr = buf + request->scanned;
+
+  while ((ptr = memchr(ptr, '\n', end - ptr)))
+  {
+    char *next = ptr + 1;
+    if (next < end && *next == '\r')
+      next++;
+    if (next < end && *next == '\n')
+      return next;
+    if (next >= end) // 다음 줄을 아직 받지 못함
+      break;
+    ptr++;
+  }
+  request->scanned = ptr ? ptr - buf : len;
+  return NULL;
+}
+
+// `ptr`부터 공백으로 구분된 토큰 하나를 `slice`에 저장하고 다음 토큰의 위치를 반환하는 함수
+static char *next_token(char *ptr, char *end, http_slice_t *slice)
+{
+  slice->ptr = ptr;
+  while (ptr < end && *ptr != ' ' && *ptr != '\r')
+    ptr++;
+  slice->len = ptr - slice->ptr;
+  if (ptr < end && *ptr == ' ')
+    ptr++;
+  else if (ptr < end && *ptr == '\r' && ptr + 1 == end)
+    ptr++;
+  return ptr;
+}
+
+// 조각이 `str`과 대소문자 구분 없이 정확히 같은지 확인하는 함수
+int http_slice_eq(http_slice_t slice, const char *str)
+{
+  return !strncasecmp(slice.ptr, str, slice.len) && str[slice.len] == '\0';
+}
+
+// `Connection` 헤더 값에 `name`이 토큰으로 나열되어 있는지 확인하는 함수
+// 나열된 헤더도 hop-by-hop 헤더이므로 전달하지 않아야 함 (RFC 7230 6.1)
+int http_connection_lists(http_request_t *request, http_slice_t name)
+{
+  for (int i = 0; i < request->header_cnt; i++)
+  {
+    if (!http_slice_eq(request->headers[i].name, "Connection"))
+      continue;
+
+    // `token, token, ...` 형식의 값을 `,` 단위로 나눠서 비교
+    char *ptr = request->headers[i].value.ptr, *end = ptr + request->headers[i].value.len;
+    while (ptr < end)
+    {
+      while (ptr < end && (*ptr == ',' || *ptr == ' ' || *ptr == '\t'))
+        ptr++;
+      char *token = ptr;
+      while (ptr < end && *ptr != ',')
+        ptr++;
+      char *token_end = ptr;
+      while (token_end > token && (token_end[-1] == ' ' || token_end[-1] == '\t'))
+        token_end--;
+      if (token_end - token == name.len && !strncasecmp(token, name.ptr, name.len))
+        return 1;
+    }
+  }
+  return 0;
+}
+
+// 이름이 `name`인 첫번째 헤더를 반환하는 함수 (없으면 NULL)
+http_header_t *http_find_header(http_request_t *request, const char *name)
+{
+  for (int i = 0; i < request->header_cnt; i++)
+    if (http_slice_eq(request->headers[i].name, name))
+      return &request->headers[i];
+  return NULL;
+}
+
+// `len` 바이트의 헤더 이름을 헤더 표에서 찾는 함수 (해시 한 번과 비교 한 번, 표에 없으면 `unknown_header` 반환)
+const http_header_info_t *http_lookup_header(const char *name, int len)
+{
+  unsigned int hash = HDR_HASH_SEED;
+
+  for (int i = 0; i < len; i++)
+    hash = (hash ^ (unsigned char)tolower((unsigned char)name[i])) * 16777619u;
+  const http_header_info_t *info = &header_table[hash >> (32 - HDR_TABLE_BITS)];
+  if (info->name && info->len == len && !strncasecmp(info->name, name, len))
+    return info;
+  return &unknown_header;
+}
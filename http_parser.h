@@ -0,0 +1,77 @@
+#include <stdio.h>
+
+#include "csapp.h"
+
+#define HTTP_MAX_HEADERS 64 // 요청 하나에 허용하는 최대 헤더 수
+#define HTTP_INCOMPLETE 0   // 헤더 블록을 아직 다 받지 못함
+#define HTTP_BAD_REQUEST -1 // 잘못된 형식의 요청
+
+// 읽기 버퍼 안의 문자열 조각 (NULL로 끝나지 않음)
+typedef struct
+{
+  char *ptr;
+  int len;
+} http_slice_t;
+
+typedef struct
+{
+  http_slice_t name;
+  http_slice_t value; // 앞뒤 공백을 제외한 값
+} http_header_t;
+
+// 파싱된 요청: 모든 필드는 `http_parse_request`에 전달한 버퍼를 가리킴
+typedef struct
+{
+  http_slice_t method, uri, version;
+  http_header_t headers[HTTP_MAX_HEADERS];
+  int header_cnt;
+  int scanned; // 헤더 블록의 끝을 찾기 위해 이미 검사한 바이트 수
+} http_request_t;
+
+// 헤더 표에 등록된 헤더 (표에 없는 헤더는 HDR_UNKNOWN)
+enum
+{
+  HDR_UNKNOWN,
+  HDR_HOST,
+  HDR_CONNECTION,
+  HDR_PROXY_CONNECTION,
+  HDR_USER_AGENT,
+  HDR_KEEP_ALIVE,
+  HDR_TE,
+  HDR_TRAILER,
+  HDR_UPGRADE,
+  HDR_TRANSFER_ENCODING,
+  HDR_PROXY_AUTHORIZATION,
+  HDR_PROXY_AUTHENTICATE,
+  HDR_CONTENT_LENGTH,
+  HDR_CONTENT_TYPE,
+  HDR_CACHE_CONTROL,
+  HDR_ETAG,
+  HDR_LAST_MODIFIED,
+  HDR_EXPIRES,
+  HDR_CONTENT_ENCODING,
+  HDR_COUNT
+};
+
+// 헤더별 처리 방법 (flag 조합, 0이면 그대로 전달)
+#define HDR_FORWARD 0 // 그대로 전달
+#define HDR_DROP 1    // hop-by-hop 헤더: 전달하지 않음
+#define HDR_REWRITE 2 // Proxy가 정한 값으로 바꿔서 전달
+#define HDR_CAPTURE 4 // 값을 읽어서 Proxy에서 사용
+
+typedef struct
+{
+  const char *name;
+  int len;
+  int id;
+  int request_action;  // Client -> Server 방향의 처리 방법
+  int response_action; // Server -> Client 방향의 처리 방법
+} http_header_info_t;
+
+void http_init_request(http_request_t *request);
+int http_parse_request(char *buf, int len, http_request_t *request);
+int http_slice_eq(http_slice_t slice, const char *str);
+http_header_t *http_find_header(http_request_t *request, const char *name);
+int http_connection_lists(http_request_t *request, http_slice_t name);
+const http_header_info_t *http_lookup_header(const char *name, int len);
+void http_check_header_table(void);
@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <time.h>
+#include <netinet/tcp.h>
+
+#include "csapp.h"
+
+#define ORIGIN_SLICE 65536          // 한 번에 쓰는 바디 크기 (chunked 응답의 chunk 크기)
+#define ORIGIN_OBJECT_MAX 67108864  // 분포에서 뽑는 응답 크기의 상한
+#define ORIGIN_TIMEOUT 30           // keep-alive 연결에서 다음 요청을 기다리는 시간(초)
+
+/* 응답 크기 분포 */
+#define SIZE_FIXED 0   // `fixed:N`: 항상 N바이트
+#define SIZE_UNIFORM 1 // `uniform:MIN-MAX`: MIN~MAX 균등 분포
+#define SIZE_EXP 2     // `exp:MEAN`: 평균이 MEAN인 지수 분포
+#define SIZE_PARETO 3  // `pareto:MIN,ALPHA`: 최솟값이 MIN인 파레토 분포 (웹 객체처럼 꼬리가 긴 분포)
+
+/* 응답 바디 경계 표시 방식 */
+#define FRAME_LENGTH 0  // Content-Length
+#define FRAME_CHUNKED 1 // Transfer-Encoding: chunked
+#define FRAME_CLOSE 2   // 길이 없이 연결을 닫아서 끝을 알림
+
+// 요청 하나에 보낼 응답 (query string으로 요청마다 바꿀 수 있음)
+typedef struct
+{
+  int status;      // 응답 상태 코드
+  long size;       // 바디 크기
+  long delay;      // 첫 바이트까지의 지연(ms)
+  unsigned int id; // 경로의 해시 (크기와 내용을 결정)
+} reply_t;
+
+void *thread(void *vargp);
+void serve(int fd, unsigned int seed);
+int read_request(rio_t *rio, char *method, char *uri, int *keep);
+void plan_reply(char *uri, reply_t *reply, unsigned int *seed);
+void send_reply(int fd, reply_t *reply, char *method, int keep);
+void send_body(int fd, reply_t *reply);
+int parse_size_dist(char *spec);
+long sample_size(unsigned int seed);
+double uniform01(unsigned int *seed);
+unsigned int hash_path(char *path);
+long now_ms(void);
+void sleep_ms(long ms);
+
+static int size_dist = SIZE_FIXED;
+static double size_a = 1024, size_b;       // 분포의 매개변수 (fixed: N, uniform: MIN MAX, exp: MEAN, pareto: MIN ALPHA)
+static long delay_min, delay_max;          // 첫 바이트까지의 지연 범위(ms)
+static long bandwidth;                     // 연결당 초당 전송량 (0이면 제한 없음)
+static int framing = FRAME_LENGTH;
+static char cache_control[MAXLINE];        // Cache-Control 헤더 값 (빈 문자열이면 보내지 않음)
+static double error_rate;                  // 에러로 응답할 요청의 비율 (0~1)
+static int error_status = 500;             // 에러 응답의 상태 코드
+static int stall;                          // 1이면 연결을 받기만 하고 응답하지 않음 (nop-server.py와 같은 동작)
+static unsigned int base_seed = 1;         // 에러, 지연을 뽑는 난수의 시작 값 (같은 값이면 같은 순서로 재현)
+static unsigned int conn_count;            // 지금까지 받은 연결 수 (연결마다 다른 난수 seed)
+static char pattern[ORIGIN_SLICE + 26];    // 응답 바디로 보내는 내용 ('a'~'z' 반복)
+
+int main(int argc, char **argv)
+{
+  int listenfd, opt, bad_opt = 0, *connfdp;
+  char *dash;
+  socklen_t clientlen;
+  struct sockaddr_storage clientaddr;
+  pthread_t tid;
+  signal(SIGPIPE, SIG_IGN); // Client가 먼저 연결을 닫아도 종료하지 않음
+
+  // `-s dist`: 응답 크기 분포 (`fixed:N`, `uniform:MIN-MAX`, `exp:MEAN`, `pareto:MIN,ALPHA`, 기본값 fixed:1024)
+  // `-d ms` 또는 `-d MIN-MAX`: 첫 바이트까지의 지연, `-b bytes`: 연결당 초당 전송량
+  // `-f framing`: 바디 경계 (`length`, `chunked`, `close`), `-c value`: Cache-Control 헤더 값 (ex. `max-age=60`)
+  // `-e rate`: 에러로 응답할 요청의 비율 (0~1), `-E status`: 에러 응답의 상태 코드 (기본값 500)
+  // `-r seed`: 난수 seed, `-S`: 연결을 받고 아무 응답도 하지 않음 (Proxy의 head-of-line blocking 테스트용)
+  while ((opt = getopt(argc, argv, "s:d:b:f:c:e:E:r:S")) != -1)
+  {
+    if (opt == 's')
+      bad_opt |= parse_size_dist(optarg) < 0;
+    else if (opt == 'd')
+    {
+      delay_min = delay_max = atol(optarg);
+      if ((dash = strchr(optarg, '-')))
+        delay_max = atol(dash + 1);
+    }
+    else if (opt == 'b')
+      bandwidth = atol(optarg);
+    else if (opt == 'f')
+    {
+      if (!strcmp(optarg, "length"))
+        framing = FRAME_LENGTH;
+      else if (!strcmp(optarg, "chunked"))
+        framing = FRAME_CHUNKED;
+      else if (!strcmp(optarg, "close"))
+        framing = FRAME_CLOSE;
+      else
+        bad_opt = 1;
+    }
+    else if (opt == 'c')
+      snprintf(cache_control, MAXLINE, "%s", optarg);
+    else if (opt == 'e')
+      error_rate = atof(optarg);
+    else if (opt == 'E')
+      error_status = atoi(optarg);
+    else if (opt == 'r')
+      base_seed = atoi(optarg);
+    else if (opt == 'S')
+      stall = 1;
+    else
+      bad_opt = 1;
+  }
+  if (bad_opt || argc - optind != 1 || delay_min < 0 || delay_max < delay_min || bandwidth < 0 || error_rate < 0 ||
+      error_rate > 1 || error_status < 100 || error_status > 599)
+  {
+    fprintf(stderr, "usage: %s [-s dist] [-d ms[-ms]] [-b bytes_per_sec] [-f length|chunked|close] [-c cache_control] [-e error_rate] [-E status] [-r seed] [-S] <port>\n", argv[0]);
+    exit(1);
+  }
+
+  for (int i = 0; i < sizeof(pattern); i++)
+    pattern[i] = 'a' + i % 26;
+
+  listenfd = Open_listenfd(argv[optind]);
+  while (1)
+  {
+    clientlen = sizeof(clientaddr);
+    connfdp = Malloc(sizeof(int));
+    *connfdp = Accept(listenfd, (SA *)&clientaddr, &clientlen);
+    Pthread_create(&tid, NULL, thread, connfdp);
+  }
+}
+
+// 연결 하나를 처리하는 스레드 (지연과 대역폭 제한 중에 다른 연결이 막히지 않도록 연결마다 스레드 생성)
+void *thread(void *vargp)
+{
+  int connfd = *((int *)vargp);
+  unsigned int seed = base_seed + __sync_fetch_and_add(&conn_count, 1);
+  Pthread_detach(pthread_self());
+  Free(vargp);
+
+  if (stall)
+  { // 요청을 읽지도 응답하지도 않고, Client가 연결을 닫을 때까지 대기
+    char buf[MAXBUF];
+    ssize_t n;
+    while ((n = read(connfd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+      ;
+  }
+  else
+    serve(connfd, seed);
+  Close(connfd);
+  return NULL;
+}
+
+// 연결에서 요청을 읽고 응답하는 함수 (keep-alive 요청이면 연결이 닫힐 때까지 반복)
+void serve(int fd, unsigned int seed)
+{
+  char method[MAXLINE], uri[MAXLINE];
+  int keep = 1;
+  rio_t rio;
+  reply_t reply;
+  struct timeval tv = {ORIGIN_TIMEOUT, 0};
+  int on = 1;
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // 헤더와 바디를 나눠 쓸 때 Nagle 지연이 측정값에 섞이지 않도록
+  rio_readinitb(&rio, fd);
+  while (keep && read_request(&rio, method, uri, &keep) == 0)
+  {
+    if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD"))
+    {
+      reply.status = 501;
+      reply.size = reply.delay = reply.id = 0;
+      keep = 0;
+    }
+    else
+      plan_reply(uri, &reply, &seed);
+    if (framing == FRAME_CLOSE || reply.status < 200) // 1xx 뒤에는 최종 응답을 보내지 않으므로 연결을 닫음
+      keep = 0;
+    send_reply(fd, &reply, method, keep);
+  }
+}
+
+// 요청 줄과 헤더를 읽는 함수 (연결이 닫혔거나 잘못된 요청이면 -1)
+// keep: HTTP/1.1은 `Connection: close`가 없으면, HTTP/1.0은 `Connection: keep-alive`가 있으면 1
+int read_request(rio_t *rio, char *method, char *uri, int *keep)
+{
+  char buf[MAXLINE], version[MAXLINE];
+
+  if (rio_readlineb(rio, buf, MAXLINE) <= 0 || sscanf(buf, "%s %s %s", method, uri, version) != 3)
+    return -1;
+  *keep = !strcasecmp(version, "HTTP/1.1");
+  while (1)
+  {
+    if (rio_readlineb(rio, buf, MAXLINE) <= 0)
+      return -1;
+    if (!strcmp(buf, "\r\n") || !strcmp(buf, "\n"))
+      return 0;
+    if (!strncasecmp(buf, "Connection:", 11))
+    {
+      for (char *p = buf + 11; *p; p++)
+        *p = tolower(*p);
+      if (strstr(buf + 11, "close"))
+        *keep = 0;
+      else if (strstr(buf + 11, "keep-alive"))
+        *keep = 1;
+    }
+  }
+}
+
+// 요청에 보낼 응답을 정하는 함수
+// 크기는 경로의 해시로 분포에서 뽑으므로 같은 URL은 항상 같은 크기와 내용 (캐시 테스트에 사용 가능)
+// 에러와 지연은 연결의 난수로 뽑고, `?size=N&delay=MS&status=CODE`를 붙이면 그 요청만 값을 지정
+void plan_reply(char *uri, reply_t *reply, unsigned int *seed)
+{
+  char path[MAXLINE], *query, *param, *saveptr;
+
+  snprintf(path, MAXLINE, "%s", uri);
+  if ((query = strchr(path, '?')))
+    *query++ = '\0';
+  reply->id = hash_path(path);
+  reply->size = sample_size(reply->id ^ base_seed);
+  reply->delay = delay_min + (delay_max > delay_min ? rand_r(seed) % (delay_max - delay_min + 1) : 0);
+  reply->status = error_rate > 0 && uniform01(seed) < error_rate ? error_status : 200;
+
+  for (param = query ? strtok_r(query, "&", &saveptr) : NULL; param; param = strtok_r(NULL, "&", &saveptr))
+  {
+    if (!strncmp(param, "size=", 5))
+      reply->size = atol(param + 5);
+    else if (!strncmp(param, "delay=", 6))
+      reply->delay = atol(param + 6);
+    else if (!strncmp(param, "status=", 7) && atoi(param + 7) >= 100 && atoi(param + 7) <= 599) // 범위 밖의 값은 무시
+      reply->status = atoi(param + 7);
+  }
+  if (reply->size < 0)
+    reply->size = 0;
+}
+
+// 지연 후 응답 헤더와 바디를 전송하는 함수
+void send_reply(int fd, reply_t *reply, char *method, int keep)
+{
+  char buf[MAXBUF];
+  int n = 0;
+  char *reason = reply->status == 200 ? "OK" : reply->status == 501 ? "Not Implemented" : "Synthetic Response";
+  int no_body = reply->status < 200 || reply->status == 204 || reply->status == 304; // 바디가 없는 응답 (RFC 7230 3.3.3)
+
+  if (no_body)
+    reply->size = 0;
+  else if (reply->status != 200) // 에러 응답의 바디는 최대 64바이트
+    reply->size = reply->size < 64 ? reply->size : 64;
+  if (reply->delay > 0)
+    sleep_ms(reply->delay);
+
+  n += sprintf(buf + n, "HTTP/1.1 %d %s\r\n", reply->status, reason);
+  n += sprintf(buf + n, "Server: Origin Emulator\r\n");
+  n += sprintf(buf + n, "Content-Type: text/plain\r\n");
+  // 1xx, 204에는 Content-Length와 Transfer-Encoding을 보낼 수 없고, 304에서는 바디 길이가 아닌 값이 되므로 생략
+  if (!no_body && framing == FRAME_LENGTH)
+    n += sprintf(buf + n, "Content-Length: %ld\r\n", reply->size);
+  else if (!no_body && framing == FRAME_CHUNKED)
+    n += sprintf(buf + n, "Transfer-Encoding: chunked\r\n");
+  if (cache_control[0] && reply->status == 200)
+    n += snprintf(buf + n, MAXBUF - n, "Cache-Control: %s\r\n", cache_control);
+  n += snprintf(buf + n, MAXBUF - n, "Connection: %s\r\n\r\n", keep ? "keep-alive" : "close");
+  if (rio_writen(fd, buf, n) != n)
+    return;
+  if (!no_body && strcasecmp(method, "HEAD"))
+    send_body(fd, reply);
+}
+
+// 바디를 ORIGIN_SLICE 단위로 전송하는 함수 (대역폭 제한이 있으면 초당 bandwidth바이트에 맞춰 쉬면서 전송)
+void send_body(int fd, reply_t *reply)
+{
+  char buf[32];
+  struct iovec iov[3];
+  long sent = 0, start = now_ms(), slice = ORIGIN_SLICE;
+  int offset = reply->id % 26; // URL마다 다른 내용 ('a'~'z' 중 시작 글자)
+
+  if (bandwidth && bandwidth / 10 < slice) // 제한이 있으면 0.1초 분량씩 보내서 전송 속도를 고르게 유지
+    slice = bandwidth / 10 > 0 ? bandwidth / 10 : 1;
+  while (sent < reply->size)
+  {
+    long len = reply->size - sent < slice ? reply->size - sent : slice;
+    iov[1].iov_base = pattern + (offset + sent) % 26;
+    iov[1].iov_len = len;
+    if (framing == FRAME_CHUNKED) // chunk 크기 줄, 데이터, CRLF를 한 번에 전송
+    {
+      iov[0].iov_base = buf;
+      iov[0].iov_len = sprintf(buf, "%lx\r\n", len);
+      iov[2].iov_base = "\r\n";
+      iov[2].iov_len = 2;
+      if (rio_writev(fd, iov, 3) < 0)
+        return;
+    }
+    else if (rio_writen(fd, iov[1].iov_base, len) != len)
+      return;
+    sent += len;
+    if (bandwidth) // 지금까지 보낸 양이 제한 속도보다 앞서 있으면 그만큼 대기
+      sleep_ms(start + sent * 1000 / bandwidth - now_ms());
+  }
+  if (framing == FRAME_CHUNKED)
+    rio_writen(fd, "0\r\n\r\n", 5);
+}
+
+// `-s` 옵션의 크기 분포를 설정하는 함수 (잘못된 형식이면 -1)
+int parse_size_dist(char *spec)
+{
+  if (sscanf(spec, "fixed:%lf", &size_a) == 1)
+    size_dist = SIZE_FIXED;
+  else if (sscanf(spec, "uniform:%lf-%lf", &size_a, &size_b) == 2 && size_b >= size_a)
+    size_dist = SIZE_UNIFORM;
+  else if (sscanf(spec, "exp:%lf", &size_a) == 1)
+    size_dist = SIZE_EXP;
+  else if (sscanf(spec, "pareto:%lf,%lf", &size_a, &size_b) == 2 && size_b > 0)
+    size_dist = SIZE_PARETO;
+  else
+    return -1;
+  return size_a < 0 ? -1 : 0;
+}
+
+// 크기 분포에서 seed로 응답 크기를 뽑는 함수 (ORIGIN_OBJECT_MAX를 넘지 않음)
+long sample_size(unsigned int seed)
+{
+  double size, u = uniform01(&seed);
+
+  if (size_dist == SIZE_UNIFORM)
+    size = size_a + u * (size_b - size_a + 1);
+  else if (size_dist == SIZE_EXP)
+    size = -size_a * log(1 - u);
+  else if (size_dist == SIZE_PARETO)
+    size = size_a / pow(1 - u, 1 / size_b);
+  else
+    size = size_a;
+  return size < ORIGIN_OBJECT_MAX ? (long)size : ORIGIN_OBJECT_MAX;
+}
+
+// [0, 1) 균등 난수
+double uniform01(unsigned int *seed)
+{
+  return rand_r(seed) / ((double)RAND_MAX + 1);
+}
+
+// 경로 문자열의 FNV-1a 해시
+unsigned int hash_path(char *path)
+{
+  unsigned int h = 2166136261u;
+
+  for (; *path; path++)
+    h = (h ^ (unsigned char)*path) * 16777619u;
+  return h;
+}
+
+long now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+void sleep_ms(long ms)
+{
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+
+  if (ms > 0)
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+
+#include "csapp.h"
+#include "prefetch.h"
+
+int prefetch_threads = 0;
+int prefetch_budget = DEFAULT_PREFETCH_BUDGET;
+
+static sem_t mutex; // 프리페치 대기열과 예산을 보호하는 세마포어
+static sem_t items; // 대기 중인 링크 수
+
+// 프리페치 대기열: 받아올 차례를 기다리거나(QUEUED) 받아오는 중인(FETCHING) 링크
+#define SLOT_FREE 0
+#define SLOT_QUEUED 1
+#define SLOT_FETCHING 2
+
+static prefetch_t slots[PREFETCH_QUEUE_SIZE];
+static int slot_state[PREFETCH_QUEUE_SIZE];
+static unsigned long slot_seq[PREFETCH_QUEUE_SIZE]; // 먼저 들어온 링크부터 받아오기 위한 순번
+static unsigned long next_seq = 0;
+
+static time_t budget_second; // 예산을 사용 중인 시각(초)
+static int budget_used;      // `budget_second` 동안 사용한 바이트 수
+
+static int resolve_link(char *host, char *port, char *base, char *url, char *path);
+static void remove_dot_segments(char *path);
+static void enqueue_prefetch(char *host, char *port, char *path);
+
+void init_prefetch(void)
+{
+  Sem_init(&mutex, 0, 1);
+  Sem_init(&items, 0, 0);
+}
+
+// HTML Body에서 `src=`, `href=` 속성을 찾아 같은 origin의 링크를 프리페치 대기열에 추가하는 함수
+// `body`는 NULL로 끝나지 않을 수 있으므로 `length`까지만 검사
+void scan_links(char *host, char *port, char *path, char *body, int length)
+{
+  char *ptr = body, *end = body + length, *url;
+  char url_buf[MAXLINE], link_path[MAXLINE];
+  int found = 0, skip;
+
+  while (ptr < end && found < MAX_PREFETCH_LINKS)
+  {
+    if (end - ptr >= 4 && !strncmp(ptr, "<!--", 4)) // 주석 안의 링크는 무시
+    {
+      for (ptr += 4; ptr + 3 <= end && strncmp(ptr, "-->", 3); ptr++)
+        ;
+      ptr += 3;
+      continue;
+    }
+
+    skip = 0;
+    if (end - ptr > 4 && !strncasecmp(ptr, "src=", 4))
+      skip = 4;
+    else if (end - ptr > 5 && !strncasecmp(ptr, "href=", 5))
+      skip = 5;
+    if (!skip || ptr == body || !isspace((unsigned char)ptr[-1])) // 속성 이름 앞에는 공백이 있어야 함 (ex. `data-src=` 제외)
+    {
+      ptr++;
+      continue;
+    }
+
+    // 따옴표로 감싸진 값 혹은 공백/`>` 전까지의 값 추출
+    ptr += skip;
+    char quote = (*ptr == '"' || *ptr == '\'') ? *ptr++ : 0;
+    for (url = ptr; ptr < end && (quote ? *ptr != quote : !isspace((unsigned char)*ptr) && *ptr != '>'); ptr++)
+      ;
+    if (ptr >= end || ptr == url || ptr - url >= MAXLINE)
+      continue;
+    memcpy(url_buf, url, ptr - url);
+    url_buf[ptr - url] = '\0';
+
+    if (resolve_link(host, port, path, url_buf, link_path))
+    {
+      enqueue_prefetch(host, port, link_path);
+      found++;
+    }
+  }
+}
+
+// 페이지(`base`) 기준의 링크(`url`)를 같은 origin의 path로 변환하는 함수 (다른 origin이거나 변환할 수 없으면 0 반환)
+// url 형태: `http://host:port/path`, `//host/path`, `/path`, `path`
+static int resolve_link(char *host, char *port, char *base, char *url, char *path)
+{
+  char link_host[MAXLINE], *link_port = "80";
+  char *hash_ptr = strchr(url, '#'); // fragment는 Server로 전송하지 않음
+  if (hash_ptr)
+    *hash_ptr = '\0';
+  if (!*url)
+    return 0;
+
+  if (!strncasecmp(url, "http://", 7) || !strncmp(url, "//", 2))
+  {
+    char *host_ptr = strstr(url, "//") + 2;
+    char *path_ptr = strchr(host_ptr, '/');
+    int host_len = path_ptr ? path_ptr - host_ptr : strlen(host_ptr);
+    snprintf(link_host, MAXLINE, "%.*s", host_len, host_ptr);
+    char *port_ptr = strchr(link_host, ':');
+    if (port_ptr)
+    {
+      *port_ptr = '\0';
+      link_port = port_ptr + 1;
+    }
+    if (strcasecmp(link_host, host) || strcmp(link_port, port)) // 다른 origin
+      return 0;
+    snprintf(path, MAXLINE, "%s", path_ptr ? path_ptr : "/");
+  }
+  else if (url[0] == '/')
+    snprintf(path, MAXLINE, "%s", url);
+  else if (url[strcspn(url, ":/?")] == ':') // `mailto:`, `javascript:`, `https:` 등 다른 scheme
+    return 0;
+  else // 상대 경로: 페이지의 디렉터리 뒤에 이어 붙임
+  {
+    int dir_len = strcspn(base, "?");
+    while (dir_len > 0 && base[dir_len - 1] != '/')
+      dir_len--;
+    snprintf(path, MAXLINE, "%.*s%s", dir_len, base, url);
+  }
+  remove_dot_segments(path); // 같은 리소스가 여러 path(캐시 키)로 저장되지 않도록 정규화
+  return strcmp(path, base) != 0;
+}
+
+// `/`로 시작하는 path에서 `.`, `..` segment를 제거하는 함수 (ex. `/a/./b/../c` -> `/a/c`, query는 그대로 둠)
+static void remove_dot_segments(char *path)
+{
+  char buf[MAXLINE], *seg = path + 1, *query = path + strcspn(path, "?");
+  int n = 0, len;
+
+  if (path[0] != '/')
+    return;
+  while (seg <= query)
+  {
+    len = strcspn(seg, "/?");
+    int dot = len == 1 && seg[0] == '.';
+    int dot_dot = len == 2 && seg[0] == '.' && seg[1] == '.';
+    if (!dot && !dot_dot)
+      n += snprintf(buf + n, MAXLINE - n, "/%.*s", len, seg);
+    else
+    {
+      while (dot_dot && n > 0 && buf[--n] != '/') // 이전 segment 제거 (root 위로는 올라가지 않음)
+        ;
+      if (seg + len >= query) // `/a/..`, `/a/.`는 디렉터리를 가리키므로 마지막 `/`를 남김
+        buf[n++] = '/';
+    }
+    seg += len + 1;
+  }
+  snprintf(buf + n, MAXLINE - n, "%s", query);
+  strcpy(path, buf);
+}
+
+// 링크를 프리페치 대기열에 추가하는 함수 (이미 대기 중이거나 대기열이 가득 차면 무시)
+static void enqueue_prefetch(char *host, char *port, char *path)
+{
+  int i, free_slot = -1;
+
+  P(&mutex);
+  for (i = 0; i < PREFETCH_QUEUE_SIZE; i++)
+  {
+    if (slot_state[i] == SLOT_FREE)
+      free_slot = free_slot < 0 ? i : free_slot;
+    else if (!strcmp(slots[i].path, path) && !strcmp(slots[i].host, host) && !strcmp(slots[i].port, port))
+      break;
+  }
+  if (i == PREFETCH_QUEUE_SIZE && free_slot >= 0)
+  {
+    snprintf(slots[free_slot].host, sizeof(slots[free_slot].host), "%s", host);
+    snprintf(slots[free_slot].port, sizeof(slots[free_slot].port), "%s", port);
+    snprintf(slots[free_slot].path, MAXLINE, "%s", path);
+    slot_state[free_slot] = SLOT_QUEUED;
+    slot_seq[free_slot] = next_seq++;
+    V(&items);
+  }
+  V(&mutex);
+}
+
+// 가장 먼저 대기열에 들어온 링크를 `item`에 복사하는 함수 (대기열이 빌 때는 대기)
+// 받아오기를 마치면 `done_prefetch`를 호출해야 함
+void dequeue_prefetch(prefetch_t *item)
+{
+  int oldest = -1;
+
+  P(&items);
+  P(&mutex);
+  for (int i = 0; i < PREFETCH_QUEUE_SIZE; i++)
+    if (slot_state[i] == SLOT_QUEUED && (oldest < 0 || slot_seq[i] < slot_seq[oldest]))
+      oldest = i;
+  slot_state[oldest] = SLOT_FETCHING;
+  *item = slots[oldest];
+  V(&mutex);
+}
+
+// 받아오기를 마친 링크를 대기열에서 제거하는 함수
+void done_prefetch(prefetch_t *item)
+{
+  P(&mutex);
+  for (int i = 0; i < PREFETCH_QUEUE_SIZE; i++)
+    if (slot_state[i] == SLOT_FETCHING && !strcmp(slots[i].path, item->path) &&
+        !strcmp(slots[i].host, item->host) && !strcmp(slots[i].port, item->port))
+    {
+      slot_state[i] = SLOT_FREE;
+      break;
+    }
+  V(&mutex);
+}
+
+// 이번 1초의 프리페치 예산에서 `bytes`만큼 사용하는 함수 (예산이 부족하면 0 반환)
+int take_prefetch_budget(int bytes)
+{
+  int ok;
+  time_t now = time(NULL);
+
+  P(&mutex);
+  if (now != budget_second)
+  {
+    budget_second = now;
+    budget_used = 0;
+  }
+  ok = budget_used + bytes <= prefetch_budget;
+  if (ok)
+    budget_used += bytes;
+  V(&mutex);
+  return ok;
+}
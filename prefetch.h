@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "csapp.h"
+
+// 미리 받아올 하위 리소스 (같은 origin의 path)
+typedef struct
+{
+  char host[256];
+  char port[16];
+  char path[MAXLINE];
+} prefetch_t;
+
+void init_prefetch(void);
+void scan_links(char *host, char *port, char *path, char *body, int length);
+void dequeue_prefetch(prefetch_t *item);
+void done_prefetch(prefetch_t *item);
+int take_prefetch_budget(int bytes);
+
+extern int prefetch_threads; // 프리페치 스레드 수 (0이면 프리페치 사용 안 함)
+extern int prefetch_budget;  // 1초 동안 프리페치로 받아올 수 있는 최대 바이트 수
+
+#define PREFETCH_QUEUE_SIZE 32  // 프리페치 대기열 크기
+#define MAX_PREFETCH_LINKS 16   // 한 페이지에서 추출할 최대 링크 수
+#define DEFAULT_PREFETCH_BUDGET 1048576
@@ -0,0 +1,198 @@
+#include <stdio.h>
+
+#include "csapp.h"
+#include "prio.h"
+
+static sem_t mutex;                        // 버퍼 풀을 보호하는 세마포어
+static char *small_pool[PRIO_POOL_SMALL]; // 반환된 작은 버퍼
+static char *large_pool[PRIO_POOL_LARGE]; // 반환된 큰 버퍼
+static int small_cnt, large_cnt;
+
+static void attach_buf(prio_t *rp, size_t size);
+static void detach_buf(prio_t *rp);
+static ssize_t prio_fill(prio_t *rp, size_t want);
+
+void init_prio_pool(void)
+{
+  Sem_init(&mutex, 0, 1);
+}
+
+void prio_readinitb(prio_t *rp, int fd)
+{
+  rp->fd = fd;
+  rp->buf = rp->bufptr = NULL;
+  rp->size = rp->cnt = 0;
+}
+
+// 한 줄(`\n`까지)을 `usrbuf`에 복사하는 함수 (rio_readlineb와 같은 동작, 에러 시에도 `usrbuf`는 NULL로 끝남)
+ssize_t prio_readlineb(prio_t *rp, char *usrbuf, size_t maxlen)
+{
+  size_t n = 0, cnt;
+  ssize_t rc;
+  char *nl = NULL;
+
+  if (maxlen == 0)
+    return 0;
+  while (!nl && n < maxlen - 1)
+  {
+    if ((rc = prio_fill(rp, PRIO_SMALL_SIZE)) < 0)
+    {
+      usrbuf[n] = '\0';
+      return -1;
+    }
+    else if (rc == 0) // EOF
+      break;
+
+    cnt = maxlen - 1 - n;
+    if (rp->cnt < cnt)
+      cnt = rp->cnt;
+    if ((nl = memchr(rp->bufptr, '\n', cnt)))
+      cnt = nl - rp->bufptr + 1;
+    memcpy(usrbuf + n, rp->bufptr, cnt);
+    rp->bufptr += cnt;
+    rp->cnt -= cnt;
+    n += cnt;
+    if (!rp->cnt) // 남은 데이터가 없으면 버퍼를 풀에 반환
+      detach_buf(rp);
+  }
+  usrbuf[n] = '\0';
+  return n;
+}
+
+// `n` 바이트를 `usrbuf`에 읽는 함수 (rio_readnb와 같은 동작)
+// 버퍼에 남은 데이터를 먼저 복사하고, 나머지는 readv로 `usrbuf`에 직접 읽으면서 넘치는 데이터만 버퍼에 받음
+ssize_t prio_readnb(prio_t *rp, void *usrbuf, size_t n)
+{
+  size_t nleft = n, cnt;
+  ssize_t nread;
+  char *bufp = usrbuf;
+  struct iovec iov[2];
+
+  while (nleft > 0)
+  {
+    if (rp->cnt > 0) // 1️⃣ 버퍼에 남은 데이터 복사
+    {
+      cnt = rp->cnt < nleft ? rp->cnt : nleft;
+      memcpy(bufp, rp->bufptr, cnt);
+      rp->bufptr += cnt;
+      rp->cnt -= cnt;
+      if (!rp->cnt)
+        detach_buf(rp);
+      nleft -= cnt;
+      bufp += cnt;
+      continue;
+    }
+    if (nleft < PRIO_SMALL_SIZE) // 2️⃣ 적게 남았으면 버퍼를 채운 뒤 복사 (작은 read 여러 번을 피함)
+    {
+      if ((nread = prio_fill(rp, nleft)) < 0)
+        return -1;
+      if (nread == 0)
+        break;
+      continue;
+    }
+
+    // 3️⃣ 많이 남았으면 `usrbuf`에 직접 읽고, 요청보다 많이 도착한 데이터는 큰 버퍼에 받음
+    attach_buf(rp, PRIO_LARGE_SIZE);
+    iov[0].iov_base = bufp;
+    iov[0].iov_len = nleft;
+    iov[1].iov_base = rp->buf;
+    iov[1].iov_len = rp->size;
+    if ((nread = readv(rp->fd, iov, 2)) < 0)
+    {
+      detach_buf(rp);
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (nread == 0) // EOF
+    {
+      detach_buf(rp);
+      break;
+    }
+    if ((size_t)nread > nleft)
+    {
+      rp->cnt = nread - nleft;
+      rp->bufptr = rp->buf;
+      nread = nleft;
+    }
+    else
+      detach_buf(rp);
+    nleft -= nread;
+    bufp += nread;
+  }
+  return n - nleft;
+}
+
+// 읽지 않은 데이터를 버리고 버퍼를 풀에 반환하는 함수 (연결을 닫기 전에 호출)
+void prio_release(prio_t *rp)
+{
+  rp->cnt = 0;
+  detach_buf(rp);
+}
+
+// 버퍼가 비어 있으면 다시 채우는 함수: 읽지 않은 바이트 수, EOF면 0, 에러면 -1 반환
+// `want`가 작은 버퍼보다 크면 큰 버퍼를 사용
+static ssize_t prio_fill(prio_t *rp, size_t want)
+{
+  ssize_t rc;
+
+  while (rp->cnt == 0)
+  {
+    attach_buf(rp, want > PRIO_SMALL_SIZE ? PRIO_LARGE_SIZE : PRIO_SMALL_SIZE);
+    if ((rc = read(rp->fd, rp->buf, rp->size)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      detach_buf(rp);
+      return -1;
+    }
+    if (rc == 0) // EOF
+    {
+      detach_buf(rp);
+      return 0;
+    }
+    rp->cnt = rc;
+    rp->bufptr = rp->buf;
+  }
+  return rp->cnt;
+}
+
+// 빈 rio에 `size` 크기의 버퍼를 붙이는 함수 (이미 그 이상의 버퍼가 있으면 그대로 사용)
+static void attach_buf(prio_t *rp, size_t size)
+{
+  if (rp->buf && rp->size >= size)
+    return;
+  detach_buf(rp);
+
+  char *buf = NULL;
+  P(&mutex);
+  if (size == PRIO_LARGE_SIZE && large_cnt > 0)
+    buf = large_pool[--large_cnt];
+  else if (size == PRIO_SMALL_SIZE && small_cnt > 0)
+    buf = small_pool[--small_cnt];
+  V(&mutex);
+  rp->buf = buf ? buf : Malloc(size);
+  rp->size = size;
+}
+
+// 비어 있는 rio의 버퍼를 풀에 반환하는 함수 (풀이 가득 차면 해제)
+static void detach_buf(prio_t *rp)
+{
+  int pooled = 1;
+
+  if (!rp->buf)
+    return;
+
+  P(&mutex);
+  if (rp->size == PRIO_LARGE_SIZE && large_cnt < PRIO_POOL_LARGE)
+    large_pool[large_cnt++] = rp->buf;
+  else if (rp->size == PRIO_SMALL_SIZE && small_cnt < PRIO_POOL_SMALL)
+    small_pool[small_cnt++] = rp->buf;
+  else
+    pooled = 0;
+  V(&mutex);
+  if (!pooled)
+    Free(rp->buf);
+  rp->buf = rp->bufptr = NULL;
+  rp->size = 0;
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+#include "csapp.h"
+
+#define PRIO_SMALL_SIZE RIO_BUFSIZE // 줄 단위 읽기(헤더)에 사용하는 버퍼 크기
+#define PRIO_LARGE_SIZE 65536       // 대용량 읽기(Body)에 사용하는 버퍼 크기
+#define PRIO_POOL_SMALL 64          // 풀에 보관할 작은 버퍼 최대 개수
+#define PRIO_POOL_LARGE 16          // 풀에 보관할 큰 버퍼 최대 개수
+
+// 공유 풀의 버퍼를 사용하는 rio: 읽지 않은 데이터가 남아 있는 동안만 버퍼를 붙잡고, 다 읽으면 풀에 반환
+typedef struct
+{
+  int fd;
+  char *buf;    // 풀에서 빌린 버퍼 (읽지 않은 데이터가 없으면 NULL)
+  size_t size;  // `buf`의 크기 (PRIO_SMALL_SIZE 혹은 PRIO_LARGE_SIZE)
+  size_t cnt;   // 읽지 않은 바이트 수
+  char *bufptr; // 다음에 읽을 위치
+} prio_t;
+
+void init_prio_pool(void);
+void prio_readinitb(prio_t *rp, int fd);
+ssize_t prio_readlineb(prio_t *rp, char *usrbuf, size_t maxlen);
+ssize_t prio_readnb(prio_t *rp, void *usrbuf, size_t n);
+void prio_release(prio_t *rp);
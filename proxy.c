@@ -3,180 +3,484 @@
 
 #include "csapp.h"
 #include "cache.h"
+#include "prefetch.h"
+#include "sbuf.h"
+#include "http_parser.h"
+#include "arena.h"
+#include "prio.h"
+#include "sockopt.h"
+
+#define NTHREADS 32 // 연결을 처리할 worker 스레드 수
+#define SBUFSIZE 64 // 처리를 기다리는 연결 대기열 크기
+#define WORKER_STACK_SIZE 262144 // worker 스레드 스택 크기 (요청 버퍼는 아레나에 두므로 기본 8MB보다 작게 사용)
+#define MAX_BODY_SIZE 67108864   // 한 번에 받아서 전달하는 Response Body의 최대 크기 (Content-length가 더 크면 502 응답)
 
 void *thread(void *vargp);
-void doit(int clientfd);
-void read_requesthdrs(rio_t *rp, void *buf, int serverfd, char *hostname, char *port);
-void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);
-void parse_uri(char *uri, char *hostname, char *port, char *path);
+void *refresher(void *vargp);
+void *prefetcher(void *vargp);
+void doit(int clientfd, arena_t *arena);
+int fetch_object(char *host, char *port, char *path, int is_prefetch);
+int serve_stale(web_object_t *stale_object, int clientfd);
+void read_requesthdrs(http_request_t *request, char *request_line, int serverfd, char *hostname, char *port);
+void clienterror(arena_t *arena, int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);
+void parse_uri(http_slice_t uri, char *hostname, char *port, char *path);
+static const char *read_responsehdr(char *line, int *content_length, cache_control_t *cc, int *is_html);
+static const char *rewrite_hdr(int id);
+static void add_iov(struct iovec *iov, int *iovcnt, const void *ptr, size_t len);
 
 static const int is_local_test = 1; // 테스트 환경에 따른 도메인&포트 지정을 위한 상수 (0 할당 시 도메인&포트가 고정되어 외부에서 접속 가능)
+static sbuf_t sbuf; // worker 스레드에 전달할 연결 대기열
 static const char *user_agent_hdr =
     "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 "
     "Firefox/10.0.3\r\n";
+static const char *proxy_connection_hdr = "Proxy-Connection: close\r\n";
+static const char *connection_hdr = "Connection: close\r\n";
 
 int main(int argc, char **argv)
 {
-  int listenfd, *clientfd;
+  int listenfd, clientfd;
   char client_hostname[MAXLINE], client_port[MAXLINE];
   socklen_t clientlen;
   struct sockaddr_storage clientaddr;
   pthread_t tid;
+  pthread_attr_t worker_attr;
+  int opt, bad_opt = 0;
   signal(SIGPIPE, SIG_IGN); // SIGPIPE 예외처리
 
-  rootp = (web_object_t *)calloc(1, sizeof(web_object_t));
-  lastp = (web_object_t *)calloc(1, sizeof(web_object_t));
+  http_check_header_table();
+  init_cache();
 
-  if (argc != 2)
+  // `-n status=ttl`: 에러 응답(혹은 `connect=ttl`: 연결 실패)의 negative 캐시 TTL 지정
+  // `-t ttl`: `max-age`가 없는 응답의 신선 유지 시간 (기본값 0: 만료 없음)
+  // `-w sec`, `-e sec`: 기본 stale-while-revalidate, stale-if-error 시간
+  // `-p threads`: HTML 하위 리소스 프리페치 스레드 수 (0이면 사용 안 함), `-b bytes`: 초당 프리페치 예산
+  // `-c opts`, `-u opts`: Client 쪽, Server 쪽 소켓 옵션 (ex. `nodelay,cork,sndbuf=65536,rcvbuf=65536,defer=1,fastopen=16`)
+  while ((opt = getopt(argc, argv, "n:t:w:e:p:b:c:u:")) != -1)
   {
-    fprintf(stderr, "usage: %s <port>\n", argv[0]);
+    if (opt == 'n')
+      bad_opt |= set_negative_ttl(optarg) < 0;
+    else if (opt == 't')
+      default_ttl = atoi(optarg);
+    else if (opt == 'w')
+      default_swr = atoi(optarg);
+    else if (opt == 'e')
+      default_sie = atoi(optarg);
+    else if (opt == 'p')
+      prefetch_threads = atoi(optarg);
+    else if (opt == 'b')
+      prefetch_budget = atoi(optarg);
+    else if (opt == 'c')
+      bad_opt |= parse_sockopt(optarg, &client_sockopt) < 0;
+    else if (opt == 'u')
+      bad_opt |= parse_sockopt(optarg, &server_sockopt) < 0;
+    else
+      bad_opt = 1;
+  }
+
+  if (bad_opt || argc - optind != 1)
+  {
+    fprintf(stderr, "usage: %s [-n status=ttl | -n connect=ttl]... [-t ttl] [-w swr] [-e sie] [-p threads] [-b bytes] [-c opts] [-u opts] <port>\n", argv[0]);
     exit(1);
   }
 
-  listenfd = Open_listenfd(argv[1]); // 전달받은 포트 번호를 사용해 수신 소켓 생성
+  for (int i = 0; i < REFRESH_THREADS; i++) // stale 객체를 갱신할 백그라운드 스레드
+    Pthread_create(&tid, NULL, refresher, NULL);
+  init_prefetch();
+  init_prio_pool();
+  for (int i = 0; i < prefetch_threads; i++) // HTML 하위 리소스를 미리 받아올 스레드
+    Pthread_create(&tid, NULL, prefetcher, NULL);
+
+  // Prethreaded 프록시: 미리 만든 worker 스레드가 대기열의 연결을 처리
+  // (worker가 오래 살아있어야 스레드별 L1 캐시가 의미 있음)
+  sbuf_init(&sbuf, SBUFSIZE);
+  pthread_attr_init(&worker_attr);
+  pthread_attr_setstacksize(&worker_attr, WORKER_STACK_SIZE);
+  for (int i = 0; i < NTHREADS; i++)
+    Pthread_create(&tid, &worker_attr, thread, NULL);
+
+  listenfd = open_listenfd_sockopt(argv[optind], &client_sockopt); // 전달받은 포트 번호를 사용해 수신 소켓 생성
+  if (listenfd < 0)
+    unix_error("open_listenfd_sockopt error");
   while (1)
   {
     clientlen = sizeof(clientaddr);
-    clientfd = Malloc(sizeof(int));
-    *clientfd = Accept(listenfd, (SA *)&clientaddr, &clientlen); // 클라이언트 연결 요청 수신
+    clientfd = Accept(listenfd, (SA *)&clientaddr, &clientlen); // 클라이언트 연결 요청 수신
+    set_sockopt(clientfd, &client_sockopt);
     Getnameinfo((SA *)&clientaddr, clientlen, client_hostname, MAXLINE, client_port, MAXLINE, 0);
     printf("Accepted connection from (%s, %s)\n", client_hostname, client_port);
-    Pthread_create(&tid, NULL, thread, clientfd); // Concurrent 프록시
+    sbuf_insert(&sbuf, clientfd); // Concurrent 프록시
   }
 }
 
 void *thread(void *vargp)
 {
-  int clientfd = *((int *)vargp);
+  arena_t arena; // 요청 처리 중에 사용하는 버퍼를 할당할 worker 전용 아레나
+
   Pthread_detach(pthread_self());
-  Free(vargp);
-  doit(clientfd);
-  Close(clientfd);
+  arena_init(&arena);
+  while (1)
+  {
+    if (sbuf_empty(&sbuf)) // 대기 상태로 들어가기 전에 L1 캐시의 참조를 반환 (캐시에서 제거된 객체가 메모리에 남지 않도록)
+      flush_l1_cache();
+    int clientfd = sbuf_remove(&sbuf);
+    doit(clientfd, &arena);
+    Close(clientfd);
+    arena_reset(&arena); // 요청이 끝나면 요청 중에 할당한 메모리를 한 번에 반환
+  }
   return NULL;
 }
 
-void doit(int clientfd)
+// 대기열에서 stale 객체를 꺼내 Server로부터 다시 받아오는 스레드
+void *refresher(void *vargp)
 {
-  int serverfd, content_length;
-  char request_buf[MAXLINE], response_buf[MAXLINE];
-  char method[MAXLINE], uri[MAXLINE], path[MAXLINE], hostname[MAXLINE], port[MAXLINE];
-  char *response_ptr, filename[MAXLINE], cgiargs[MAXLINE];
-  rio_t request_rio, response_rio;
+  Pthread_detach(pthread_self());
+  while (1)
+  {
+    web_object_t *stale_object = dequeue_refresh();
+    fetch_object(stale_object->host, stale_object->port, stale_object->path, 0);
+    finish_refresh(stale_object);
+  }
+  return NULL;
+}
 
-  /* 1️⃣ -1) Request Line 읽기 [🙋‍♀️ Client -> 🚒 Proxy] */
-  Rio_readinitb(&request_rio, clientfd);
-  Rio_readlineb(&request_rio, request_buf, MAXLINE);
-  printf("Request headers:\n %s\n", request_buf);
+// 대기열에서 HTML 하위 리소스 링크를 꺼내 캐시에 미리 받아오는 스레드
+void *prefetcher(void *vargp)
+{
+  int cache_state;
+  prefetch_t item;
 
-  // 요청 라인 parsing을 통해 `method, uri, hostname, port, path` 찾기
-  sscanf(request_buf, "%s %s", method, uri);
-  parse_uri(uri, hostname, port, path);
+  Pthread_detach(pthread_self());
+  while (1)
+  {
+    dequeue_prefetch(&item);
+    web_object_t *cached_object = find_cache(item.path, &cache_state);
+    if (cached_object) // 이미 캐싱된 리소스는 받아오지 않음
+      release_cache(cached_object);
+    else
+      fetch_object(item.host, item.port, item.path, 1);
+    done_prefetch(&item);
+  }
+  return NULL;
+}
+
+void doit(int clientfd, arena_t *arena)
+{
+  int serverfd, content_length = 0, status = 0, cache_state, is_html = 0, hdr_len = 0, rc;
+  int response_hdr_len = 0, hdr_sent = 0, n;
+  char status_msg[64] = "", method[16];
+  struct iovec iov[2];
+  char *response_ptr;
+  cache_control_t cache_control;
+  prio_t response_rio; // Server 응답을 읽는 동안에만 공유 풀의 버퍼를 사용
+
+  // 요청 처리에 필요한 버퍼는 스택 대신 worker의 아레나에서 할당 (요청이 끝나면 `arena_reset`으로 반환)
+  char *request_buf = arena_alloc(arena, MAXLINE), *response_buf = arena_alloc(arena, MAXLINE);
+  char *request_hdr = arena_alloc(arena, MAXBUF), *response_hdr = arena_alloc(arena, MAXBUF);
+  char *path = arena_alloc(arena, MAXLINE), *hostname = arena_alloc(arena, MAXLINE), *port = arena_alloc(arena, MAXLINE);
+  http_request_t *request = arena_alloc(arena, sizeof(http_request_t));
+
+  /* 1️⃣ -1) Request Line & Header 읽기 [🙋‍♀️ Client -> 🚒 Proxy] */
+  // 빈 줄이 올 때까지 읽은 뒤, 요청 라인과 헤더 블록 전체를 복사 없이 한 번에 파싱
+  http_init_request(request);
+  while ((rc = http_parse_request(request_hdr, hdr_len, request)) == HTTP_INCOMPLETE)
+  {
+    if (hdr_len == MAXBUF) // 헤더 블록이 버퍼보다 큰 경우
+    {
+      rc = HTTP_BAD_REQUEST;
+      break;
+    }
+    ssize_t n = read(clientfd, request_hdr + hdr_len, MAXBUF - hdr_len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) // 헤더를 다 받기 전에 연결이 끊어짐
+      return;
+    hdr_len += n;
+  }
+  if (rc == HTTP_BAD_REQUEST)
+  {
+    clienterror(arena, clientfd, "", "400", "Bad Request", "Proxy couldn't parse the request");
+    return;
+  }
+  printf("Request headers:\n %.*s\n", rc, request_hdr);
+
+  // 요청 라인의 `method, uri`로 `hostname, port, path` 찾기
+  snprintf(method, sizeof(method), "%.*s", request->method.len, request->method.ptr);
+  parse_uri(request->uri, hostname, port, path);
 
   // Server에 전송하기 위해 요청 라인의 형식 변경: `method uri version` -> `method path HTTP/1.0`
   sprintf(request_buf, "%s %s %s\r\n", method, path, "HTTP/1.0");
 
   // 지원하지 않는 method인 경우 예외 처리
-  if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD"))
+  if (!http_slice_eq(request->method, "GET") && !http_slice_eq(request->method, "HEAD"))
   {
-    clienterror(clientfd, method, "501", "Not implemented", "Tiny does not implement this method");
+    clienterror(arena, clientfd, method, "501", "Not implemented", "Tiny does not implement this method");
+    return;
+  }
+
+  // 현재 스레드의 L1 캐시에 있는 객체라면 공유 캐시를 거치지 않고 바로 전송
+  web_object_t *cached_object = find_l1_cache(path);
+  if (cached_object)
+  {
+    send_cache(cached_object, clientfd);
     return;
   }
 
   // 현재 요청이 캐싱된 요청(path)인지 확인
-  web_object_t *cached_object = find_cache(path);
-  if (cached_object) // 캐싱 되어있다면
+  // 만료된 객체라도 stale-while-revalidate 구간이면 바로 응답 (갱신은 refresher 스레드가 담당)
+  cached_object = find_cache(path, &cache_state);
+  if (cached_object && cache_state != CACHE_STALE_ERROR) // 캐싱 되어있다면
   {
     send_cache(cached_object, clientfd); // 캐싱된 객체를 Client에 전송
-    read_cache(cached_object);           // 사용한 웹 객체의 순서를 맨 앞으로 갱신
-    return;                              // Server로 요청을 보내지 않고 통신 종료
+    if (cache_state == CACHE_FRESH)      // 다시 요청된 신선한 객체는 L1 캐시에 보관
+      write_l1_cache(cached_object);
+    read_cache(cached_object); // 사용한 웹 객체의 순서를 맨 앞으로 갱신
+    return;                    // Server로 요청을 보내지 않고 통신 종료
   }
+  // 여기서 `cached_object`가 있다면 stale-if-error 객체: Server 요청이 실패한 경우에만 사용
 
+  // 최근에 연결에 실패한 Server라면 다시 연결을 시도하지 않고 바로 에러 응답
+  if (find_negative_host(hostname, port))
+  {
+    if (serve_stale(cached_object, clientfd))
+      return;
+    clienterror(arena, clientfd, method, "502", "Bad Gateway", "📍 Failed to establish connection with the end server");
+    return;
+  }
 
-  /* 1️⃣ -2) Request Line 전송 [🚒 Proxy -> 💻 Server] */
+  /* 1️⃣ -2) Server 연결 [🚒 Proxy -> 💻 Server] */
   // Server 소켓 생성
-  serverfd = is_local_test ? Open_clientfd(hostname, port) : Open_clientfd("52.79.234.188", port);
+  serverfd = is_local_test ? open_serverfd(hostname, port) : open_serverfd("52.79.234.188", port);
   if (serverfd < 0)
   {
-    clienterror(serverfd, method, "502", "Bad Gateway", "📍 Failed to establish connection with the end server");
+    write_negative_host(hostname, port); // 연결 실패 기록 (negative 캐시)
+    if (serve_stale(cached_object, clientfd))
+      return;
+    clienterror(arena, clientfd, method, "502", "Bad Gateway", "📍 Failed to establish connection with the end server");
     return;
   }
-  Rio_writen(serverfd, request_buf, strlen(request_buf));
 
-  /* 2️⃣ Request Header 읽기 & 전송 [🙋‍♀️ Client -> 🚒 Proxy -> 💻 Server] */
-  read_requesthdrs(&request_rio, request_buf, serverfd, hostname, port);
+  /* 2️⃣ Request Line & Header 전송 [🙋‍♀️ Client -> 🚒 Proxy -> 💻 Server] */
+  read_requesthdrs(request, request_buf, serverfd, hostname, port);
 
-  /* 3️⃣ Response Header 읽기 & 전송 [💻 Server -> 🚒 Proxy -> 🙋‍♀️ Client] */
-  Rio_readinitb(&response_rio, serverfd);
-  while (strcmp(response_buf, "\r\n"))
+  /* 3️⃣ Response Header 읽기 [💻 Server -> 🚒 Proxy] */
+  // 헤더는 `response_hdr`에 모아두었다가 Body와 함께 한 번의 writev로 전송
+  prio_readinitb(&response_rio, serverfd);
+  prio_readlineb(&response_rio, response_buf, MAXLINE); // 상태 라인: `HTTP/1.0 200 OK`
+  sscanf(response_buf, "%*s %d %63[^\r\n]", &status, status_msg);
+  if ((status == 0 || status >= 500) && serve_stale(cached_object, clientfd)) // Server 에러 시 stale 객체로 대신 응답
   {
-    Rio_readlineb(&response_rio, response_buf, MAXLINE);
-    if (strstr(response_buf, "Content-length")) // Response Body 수신에 사용하기 위해 Content-length 저장
-      content_length = atoi(strchr(response_buf, ':') + 1);
-    Rio_writen(clientfd, response_buf, strlen(response_buf));
+    prio_release(&response_rio);
+    Close(serverfd);
+    return;
   }
+  if (cached_object) // Server가 정상 응답한 경우 stale 객체는 새 응답으로 교체됨
+    release_cache(cached_object);
 
-  /* 4️⃣ Response Body 읽기 & 전송 [💻 Server -> 🚒 Proxy -> 🙋‍♀️ Client] */
-  response_ptr = malloc(content_length);
-  Rio_readnb(&response_rio, response_ptr, content_length);
-  Rio_writen(clientfd, response_ptr, content_length); // Client에 Response Body 전송
-
-  if (content_length <= MAX_OBJECT_SIZE) // 캐싱 가능한 크기인 경우
+  init_cache_control(&cache_control);
+  cork_socket(clientfd, &client_sockopt, 1); // 헤더가 커서 나눠 보내더라도 Body와 함께 가득 찬 세그먼트로 전송
+  while (strcmp(response_buf, "\r\n") && strcmp(response_buf, ""))
+  {
+    const char *line = read_responsehdr(response_buf, &content_length, &cache_control, &is_html);
+    if (content_length < 0) // 잘못된 Content-length는 Body를 받지 않고 502 응답
+      break;
+    if (line)
+    {
+      n = strlen(line);
+      if (response_hdr_len + n > MAXBUF) // 헤더가 버퍼보다 크면 모아둔 만큼 먼저 전송
+      {
+        rio_writen(clientfd, response_hdr, response_hdr_len);
+        response_hdr_len = 0;
+        hdr_sent = 1;
+      }
+      memcpy(response_hdr + response_hdr_len, line, n);
+      response_hdr_len += n;
+    }
+    prio_readlineb(&response_rio, response_buf, MAXLINE);
+  }
+  if (content_length < 0)
+  {
+    cork_socket(clientfd, &client_sockopt, 0);
+    if (!hdr_sent) // 헤더 일부를 이미 보냈다면 연결만 닫음
+      clienterror(arena, clientfd, method, "502", "Bad Gateway", "📍 Invalid Content-length from the end server");
+    prio_release(&response_rio);
+    Close(serverfd);
+    return;
+  }
+  n = strlen(response_buf); // 헤더 종료 줄(`\r\n`)
+  if (response_hdr_len + n > MAXBUF)
+  {
+    rio_writen(clientfd, response_hdr, response_hdr_len);
+    response_hdr_len = 0;
+  }
+  memcpy(response_hdr + response_hdr_len, response_buf, n);
+  response_hdr_len += n;
+
+  /* 4️⃣ Response Body 읽기 & Header와 함께 전송 [💻 Server -> 🚒 Proxy -> 🙋‍♀️ Client] */
+  // 캐싱할 Body만 캐시가 소유할 메모리로 받고, 나머지는 요청이 끝나면 반환되는 아레나에 받음
+  int cacheable = is_cacheable(status, content_length, &cache_control);
+  response_ptr = cacheable ? malloc(content_length) : arena_alloc(arena, content_length);
+  ssize_t body_len = response_ptr ? prio_readnb(&response_rio, response_ptr, content_length) : -1;
+  iov[0].iov_base = response_hdr;
+  iov[0].iov_len = response_hdr_len;
+  iov[1].iov_base = response_ptr;
+  iov[1].iov_len = body_len > 0 ? body_len : 0; // Body가 중간에 끊겼다면 받은 만큼만 전달
+  rio_writev(clientfd, iov, 2); // Client에 Response Header & Body 전송
+  cork_socket(clientfd, &client_sockopt, 0);
+
+  // 200 응답이거나 negative 캐싱 대상인 에러 응답이면서 캐싱 가능한 크기인 경우 `web_object` 구조체 생성
+  // (Body를 `content_length`만큼 다 받은 경우에만)
+  if (cacheable && body_len != content_length)
+    free(response_ptr);
+  else if (cacheable)
   {
-    // `web_object` 구조체 생성
-    web_object_t *web_object = (web_object_t *)calloc(1, sizeof(web_object_t));
-    web_object->response_ptr = response_ptr;
-    web_object->content_length = content_length;
-    strcpy(web_object->path, path);
+    web_object_t *web_object = create_object(path, hostname, port, status, status_msg, response_ptr, content_length, &cache_control);
+    if (prefetch_threads && is_html && status == 200) // 캐싱되는 HTML의 하위 리소스를 미리 받아옴
+      scan_links(hostname, port, path, response_ptr, content_length);
     write_cache(web_object); // 캐시 연결 리스트에 추가
   }
-  else
-    free(response_ptr); // 캐싱하지 않은 경우만 메모리 반환
 
+  prio_release(&response_rio); // 읽지 않은 데이터가 남았다면 버리고 버퍼를 풀에 반환
+  Close(serverfd);
+}
+
+// stale-if-error 객체가 있으면 Server 에러 대신 Client에 전송하는 함수 (전송했으면 1 반환)
+int serve_stale(web_object_t *stale_object, int clientfd)
+{
+  if (!stale_object)
+    return 0;
+  send_cache(stale_object, clientfd);
+  read_cache(stale_object);
+  return 1;
+}
+
+// Client 없이 Server에 `path`를 요청해 캐시에 넣는 함수 (stale 객체 갱신, 프리페치에 사용)
+// 캐시에 넣었으면 1을 반환하며, 실패하면 기존 stale 객체를 그대로 두고 다음 요청에서 다시 시도함
+int fetch_object(char *host, char *port, char *path, int is_prefetch)
+{
+  int serverfd, content_length = 0, status = 0, is_html = 0;
+  char buf[MAXLINE], status_msg[64] = "", *response_ptr;
+  cache_control_t cache_control;
+  prio_t response_rio;
+
+  if (find_negative_host(host, port))
+    return 0;
+  serverfd = is_local_test ? open_serverfd(host, port) : open_serverfd("52.79.234.188", port);
+  if (serverfd < 0)
+  {
+    write_negative_host(host, port);
+    return 0;
+  }
+
+  // Proxy가 직접 만든 요청 전송
+  int n = 0;
+  n += sprintf(buf + n, "GET %s HTTP/1.0\r\n", path);
+  n += sprintf(buf + n, "Host: %s:%s\r\n", host, port);
+  n += sprintf(buf + n, "%s", user_agent_hdr);
+  n += sprintf(buf + n, "Connection: close\r\nProxy-Connection: close\r\n\r\n");
+  if (rio_writen(serverfd, buf, n) != n)
+  {
+    Close(serverfd);
+    return 0;
+  }
+
+  // Response Header 읽기
+  init_cache_control(&cache_control);
+  prio_readinitb(&response_rio, serverfd);
+  if (prio_readlineb(&response_rio, buf, MAXLINE) <= 0)
+  {
+    prio_release(&response_rio);
+    Close(serverfd);
+    return 0;
+  }
+  sscanf(buf, "%*s %d %63[^\r\n]", &status, status_msg);
+  while (prio_readlineb(&response_rio, buf, MAXLINE) > 0 && strcmp(buf, "\r\n"))
+    read_responsehdr(buf, &content_length, &cache_control, &is_html);
+
+  // 5xx 응답은 stale 객체를 유지하고, 그 외 응답은 새 객체로 교체
+  // Content-length가 없거나(Body 길이를 알 수 없음) 캐싱할 수 없는 크기이거나 프리페치 예산을 넘는 Body는 받지 않음
+  // (프리페치도 마찬가지: 아무도 요청하지 않은 리소스가 빈 객체로 캐싱되지 않도록 write_cache 전에 포기)
+  if ((status != 200 && (status == 0 || status >= 500 || !negative_ttl(status))) || !cache_control.has_length ||
+      content_length < 0 || content_length > MAX_OBJECT_SIZE || (is_prefetch && !take_prefetch_budget(content_length)))
+  {
+    prio_release(&response_rio);
+    Close(serverfd);
+    return 0;
+  }
+  response_ptr = malloc(content_length);
+  web_object_t *web_object = NULL;
+  if (prio_readnb(&response_rio, response_ptr, content_length) == content_length)
+    web_object = create_object(path, host, port, status, status_msg, response_ptr, content_length, &cache_control);
+  if (web_object)
+  {
+    if (prefetch_threads && is_html && status == 200 && !is_prefetch) // 프리페치한 페이지의 링크는 다시 따라가지 않음
+      scan_links(host, port, path, response_ptr, content_length);
+    write_cache(web_object);
+  }
+  else
+    free(response_ptr);
+  prio_release(&response_rio);
   Close(serverfd);
+  return web_object != NULL;
 }
 
 // 클라이언트에 에러를 전송하는 함수
 // cause: 오류 원인, errnum: 오류 번호, shortmsg: 짧은 오류 메시지, longmsg: 긴 오류 메시지
-void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg)
+void clienterror(arena_t *arena, int fd, char *cause, char *errnum, char *shortmsg, char *longmsg)
 {
-  char buf[MAXLINE], body[MAXBUF];
+  char *buf = arena_alloc(arena, MAXLINE), *body = arena_alloc(arena, MAXBUF);
+  int buf_len = 0, body_len = 0;
+  struct iovec iov[2];
 
   // 에러 Bdoy 생성
-  sprintf(body, "<html><title>Tiny Error</title>");
-  sprintf(body, "%s<body bgcolor="
-                "ffffff"
-                ">\r\n",
-          body);
-  sprintf(body, "%s%s: %s\r\n", body, errnum, shortmsg);
-  sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
-  sprintf(body, "%s<hr><em>The Tiny Web server</em>\r\n", body);
-
-  // 에러 Header 생성 & 전송
-  sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-type: text/html\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-  Rio_writen(fd, buf, strlen(buf));
-
-  // 에러 Body 전송
-  Rio_writen(fd, body, strlen(body));
+  body_len += snprintf(body + body_len, MAXBUF - body_len, "<html><title>Tiny Error</title>");
+  body_len += snprintf(body + body_len, MAXBUF - body_len, "<body bgcolor="
+                                                           "ffffff"
+                                                           ">\r\n");
+  body_len += snprintf(body + body_len, MAXBUF - body_len, "%s: %s\r\n", errnum, shortmsg);
+  body_len += snprintf(body + body_len, MAXBUF - body_len, "<p>%s: %s\r\n", longmsg, cause);
+  body_len += snprintf(body + body_len, MAXBUF - body_len, "<hr><em>The Tiny Web server</em>\r\n");
+
+  // 에러 Header 생성
+  buf_len += sprintf(buf + buf_len, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
+  buf_len += sprintf(buf + buf_len, "Content-type: text/html\r\n");
+  buf_len += sprintf(buf + buf_len, "Content-length: %d\r\n\r\n", body_len);
+
+  // 에러 Header & Body를 한 번에 전송
+  iov[0].iov_base = buf;
+  iov[0].iov_len = buf_len;
+  iov[1].iov_base = body;
+  iov[1].iov_len = body_len;
+  rio_writev(fd, iov, 2);
 }
 
 // uri를 `hostname`, `port`, `path`로 파싱하는 함수
 // uri 형태: `http://hostname:port/path` 혹은 `http://hostname/path` (port는 optional)
-void parse_uri(char *uri, char *hostname, char *port, char *path)
+void parse_uri(http_slice_t uri, char *hostname, char *port, char *path)
 {
+  char *end = uri.ptr + uri.len;
+
   // host_name의 시작 위치 포인터: '//'가 있으면 //뒤(ptr+2)부터, 없으면 uri 처음부터
-  char *hostname_ptr = strstr(uri, "//") ? strstr(uri, "//") + 2 : uri;
-  char *port_ptr = strchr(hostname_ptr, ':'); // port 시작 위치 (없으면 NULL)
-  char *path_ptr = strchr(hostname_ptr, '/'); // path 시작 위치 (없으면 NULL)
-  strcpy(path, path_ptr);
+  char *hostname_ptr = uri.ptr;
+  for (char *ptr = uri.ptr; ptr + 1 < end; ptr++)
+    if (ptr[0] == '/' && ptr[1] == '/')
+    {
+      hostname_ptr = ptr + 2;
+      break;
+    }
+  char *path_ptr = memchr(hostname_ptr, '/', end - hostname_ptr); // path 시작 위치 (없으면 uri 끝)
+  if (!path_ptr)
+    path_ptr = end;
+  char *port_ptr = memchr(hostname_ptr, ':', path_ptr - hostname_ptr); // port 시작 위치 (없으면 NULL)
+
+  if (path_ptr < end)
+    snprintf(path, MAXLINE, "%.*s", (int)(end - path_ptr), path_ptr);
+  else
+    strcpy(path, "/");
 
   if (port_ptr) // port 있는 경우
   {
-    strncpy(port, port_ptr + 1, path_ptr - port_ptr - 1); 
-    strncpy(hostname, hostname_ptr, port_ptr - hostname_ptr);
+    snprintf(port, MAXLINE, "%.*s", (int)(path_ptr - port_ptr - 1), port_ptr + 1);
+    snprintf(hostname, MAXLINE, "%.*s", (int)(port_ptr - hostname_ptr), hostname_ptr);
   }
   else // port 없는 경우
   {
@@ -184,71 +488,110 @@ void parse_uri(char *uri, char *hostname, char *port, char *path)
       strcpy(port, "80"); // port의 기본 값인 80으로 설정
     else
       strcpy(port, "8000");
-    strncpy(hostname, hostname_ptr, path_ptr - hostname_ptr);
+    snprintf(hostname, MAXLINE, "%.*s", (int)(path_ptr - hostname_ptr), hostname_ptr);
   }
 }
 
-// Request Header를 읽고 Server에 전송하는 함수
-// 필수 헤더가 없는 경우에는 필수 헤더를 추가로 전송
-void read_requesthdrs(rio_t *request_rio, void *request_buf, int serverfd, char *hostname, char *port)
+// 요청 라인과 파싱된 Request Header를 Server에 전송하는 함수
+// 헤더는 헤더 표(`http_lookup_header`)로 분류해 hop-by-hop 헤더(`Connection`에 나열된 헤더 포함)는 버리고, Proxy가 정한 헤더는 값을 바꿔서 전송
+// 필수 헤더가 없는 경우에는 필수 헤더를 추가하고, 요청 전체를 한 번의 writev로 전송
+// (전달하는 헤더는 복사하지 않고 Client 요청 버퍼를 가리키는 iovec으로 전송)
+void read_requesthdrs(http_request_t *request, char *request_line, int serverfd, char *hostname, char *port)
 {
-  int is_host_exist;
-  int is_connection_exist;
-  int is_proxy_connection_exist;
-  int is_user_agent_exist;
+  struct iovec iov[2 * HTTP_MAX_HEADERS + 6];
+  char host_hdr[MAXLINE];
+  int iovcnt = 0;
+  int is_exist[HDR_COUNT] = {0}; // 요청에 포함된 헤더 (헤더 표의 id 기준)
 
-  Rio_readlineb(request_rio, request_buf, MAXLINE); // 첫번째 줄 읽기
-  while (strcmp(request_buf, "\r\n"))
+  add_iov(iov, &iovcnt, request_line, strlen(request_line));
+  for (int i = 0; i < request->header_cnt; i++)
   {
-    if (strstr(request_buf, "Proxy-Connection") != NULL)
-    {
-      sprintf(request_buf, "Proxy-Connection: close\r\n");
-      is_proxy_connection_exist = 1;
-    }
-    else if (strstr(request_buf, "Connection") != NULL)
+    http_header_t *header = &request->headers[i];
+    const http_header_info_t *info = http_lookup_header(header->name.ptr, header->name.len);
+    if (info->request_action & HDR_DROP)
+      continue;
+    if (!(info->request_action & HDR_REWRITE) && http_connection_lists(request, header->name)) // `Connection`에 나열된 헤더도 hop-by-hop
+      continue;
+    if (info->request_action & HDR_REWRITE)
     {
-      sprintf(request_buf, "Connection: close\r\n");
-      is_connection_exist = 1;
+      if (!is_exist[info->id]) // 같은 헤더가 여러 번 오더라도 한 번만 전송
+        add_iov(iov, &iovcnt, rewrite_hdr(info->id), strlen(rewrite_hdr(info->id)));
     }
-    else if (strstr(request_buf, "User-Agent") != NULL)
-    {
-      sprintf(request_buf, user_agent_hdr);
-      is_user_agent_exist = 1;
-    }
-    else if (strstr(request_buf, "Host") != NULL)
+    else
     {
-      is_host_exist = 1;
+      // `name: value` 부분은 요청 버퍼에서 그대로 사용
+      add_iov(iov, &iovcnt, header->name.ptr, header->value.ptr + header->value.len - header->name.ptr);
+      add_iov(iov, &iovcnt, "\r\n", 2);
     }
-
-    Rio_writen(serverfd, request_buf, strlen(request_buf)); // Server에 전송
-    Rio_readlineb(request_rio, request_buf, MAXLINE);       // 다음 줄 읽기
+    is_exist[info->id] = 1;
   }
 
-  // 필수 헤더 미포함 시 추가로 전송
-  if (!is_proxy_connection_exist)
-  {
-    sprintf(request_buf, "Proxy-Connection: close\r\n");
-    Rio_writen(serverfd, request_buf, strlen(request_buf));
-  }
-  if (!is_connection_exist)
-  {
-    sprintf(request_buf, "Connection: close\r\n");
-    Rio_writen(serverfd, request_buf, strlen(request_buf));
-  }
-  if (!is_host_exist)
+  // 필수 헤더 미포함 시 추가
+  if (!is_exist[HDR_PROXY_CONNECTION])
+    add_iov(iov, &iovcnt, proxy_connection_hdr, strlen(proxy_connection_hdr));
+  if (!is_exist[HDR_CONNECTION])
+    add_iov(iov, &iovcnt, connection_hdr, strlen(connection_hdr));
+  if (!is_exist[HDR_HOST])
   {
     if (!is_local_test)
       hostname = "52.79.234.188";
-    sprintf(request_buf, "Host: %s:%s\r\n", hostname, port);
-    Rio_writen(serverfd, request_buf, strlen(request_buf));
+    add_iov(iov, &iovcnt, host_hdr, sprintf(host_hdr, "Host: %s:%s\r\n", hostname, port));
   }
-  if (!is_user_agent_exist)
+  if (!is_exist[HDR_USER_AGENT])
+    add_iov(iov, &iovcnt, user_agent_hdr, strlen(user_agent_hdr));
+
+  add_iov(iov, &iovcnt, "\r\n", 2); // 종료문
+  rio_writev(serverfd, iov, iovcnt);
+}
+
+// Response Header 한 줄을 헤더 표로 분류해 Proxy에서 사용할 값을 저장하는 함수
+// Client에 전달할 줄을 반환하며, 전달하지 않는 hop-by-hop 헤더는 NULL 반환
+static const char *read_responsehdr(char *line, int *content_length, cache_control_t *cc, int *is_html)
+{
+  char *colon = strchr(line, ':');
+  if (!colon)
+    return line;
+
+  const http_header_info_t *info = http_lookup_header(line, colon - line);
+  if (info->response_action & HDR_CAPTURE)
   {
-    sprintf(request_buf, user_agent_hdr);
-    Rio_writen(serverfd, request_buf, strlen(request_buf));
+    if (info->id == HDR_CONTENT_LENGTH) // Response Body 수신에 사용하기 위해 Content-length 저장 (숫자가 아니거나 범위를 벗어나면 -1)
+    {
+      char *end;
+      long length = strtol(colon + 1, &end, 10);
+      while (isspace((unsigned char)*end))
+        end++;
+      *content_length = end == colon + 1 || *end || length < 0 || length > MAX_BODY_SIZE ? -1 : length;
+      cc->has_length = 1;
+    }
+    else if (info->id == HDR_CACHE_CONTROL) // 신선도 계산에 사용하기 위해 Cache-Control 저장
+      parse_cache_control(line, cc);
+    else if (info->id == HDR_CONTENT_TYPE && strstr(colon + 1, "text/html")) // 프리페치할 링크를 찾기 위해 HTML 여부 저장
+      *is_html = 1;
+    else if (info->id == HDR_CONTENT_ENCODING) // 캐시는 인코딩별로 객체를 구분하지 않으므로 압축된 응답은 캐싱하지 않음
+      cc->no_store = 1;
   }
+  if (info->response_action & HDR_DROP)
+    return NULL;
+  if (info->response_action & HDR_REWRITE)
+    return rewrite_hdr(info->id);
+  return line;
+}
+
+// Proxy가 값을 정하는 헤더의 전체 줄을 반환하는 함수
+static const char *rewrite_hdr(int id)
+{
+  if (id == HDR_PROXY_CONNECTION)
+    return proxy_connection_hdr;
+  if (id == HDR_USER_AGENT)
+    return user_agent_hdr;
+  return connection_hdr;
+}
 
-  sprintf(request_buf, "\r\n"); // 종료문
-  Rio_writen(serverfd, request_buf, strlen(request_buf));
-  return;
-}
\ No newline at end of file
+// iovec 배열 끝에 `len` 바이트의 `ptr`을 추가하는 함수
+static void add_iov(struct iovec *iov, int *iovcnt, const void *ptr, size_t len)
+{
+  iov[*iovcnt].iov_base = (void *)ptr;
+  iov[*iovcnt].iov_len = len;
+  (*iovcnt)++;
+}
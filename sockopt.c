@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <netinet/tcp.h>
+
+#include "csapp.h"
+#include "sockopt.h"
+
+sockopt_t client_sockopt = {.nodelay = 1, .defer_accept = 1};
+sockopt_t server_sockopt = {.nodelay = 1};
+
+static void set_listen_sockopt(int listenfd, sockopt_t *opt);
+static void set_int_opt(int fd, int level, int name, int value, char *label);
+
+// `nodelay,cork,sndbuf=65536,defer=1` 형식의 설정을 `opt`에 반영하는 함수 (잘못된 형식이면 -1 반환)
+// 값이 없는 옵션은 1, `nodelay=0`처럼 0을 지정하면 사용하지 않음
+int parse_sockopt(char *spec, sockopt_t *opt)
+{
+  char buf[MAXLINE], *name, *saveptr;
+
+  snprintf(buf, MAXLINE, "%s", spec);
+  for (name = strtok_r(buf, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr))
+  {
+    char *value_ptr = strchr(name, '=');
+    int value = 1;
+    if (value_ptr)
+    {
+      *value_ptr++ = '\0';
+      if (!*value_ptr || (value = atoi(value_ptr)) < 0)
+        return -1;
+    }
+
+    if (!strcmp(name, "nodelay"))
+      opt->nodelay = value;
+    else if (!strcmp(name, "cork"))
+      opt->cork = value;
+    else if (!strcmp(name, "sndbuf"))
+      opt->sndbuf = value;
+    else if (!strcmp(name, "rcvbuf"))
+      opt->rcvbuf = value;
+    else if (!strcmp(name, "defer"))
+      opt->defer_accept = value;
+    else if (!strcmp(name, "fastopen"))
+      opt->fastopen = value;
+    else
+      return -1;
+  }
+  return 0;
+}
+
+// 수신 소켓에 옵션을 적용하는 함수 (`open_listenfd_sockopt`가 listen 전에 호출)
+// (accept한 소켓은 수신 소켓의 버퍼 크기를 물려받고, TCP_NODELAY는 accept 후 `set_sockopt`로 적용)
+static void set_listen_sockopt(int listenfd, sockopt_t *opt)
+{
+  if (opt->sndbuf)
+    set_int_opt(listenfd, SOL_SOCKET, SO_SNDBUF, opt->sndbuf, "SO_SNDBUF");
+  if (opt->rcvbuf)
+    set_int_opt(listenfd, SOL_SOCKET, SO_RCVBUF, opt->rcvbuf, "SO_RCVBUF");
+  if (opt->defer_accept)
+    set_int_opt(listenfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, opt->defer_accept, "TCP_DEFER_ACCEPT");
+  if (opt->fastopen)
+    set_int_opt(listenfd, IPPROTO_TCP, TCP_FASTOPEN, opt->fastopen, "TCP_FASTOPEN");
+}
+
+// 연결된 소켓에 옵션을 적용하는 함수
+void set_sockopt(int fd, sockopt_t *opt)
+{
+  if (opt->nodelay)
+    set_int_opt(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+  if (opt->sndbuf)
+    set_int_opt(fd, SOL_SOCKET, SO_SNDBUF, opt->sndbuf, "SO_SNDBUF");
+  if (opt->rcvbuf)
+    set_int_opt(fd, SOL_SOCKET, SO_RCVBUF, opt->rcvbuf, "SO_RCVBUF");
+}
+
+// Header와 Body를 나눠 보내기 전후에 호출해 전송을 모으는 함수 (`cork` 옵션이 없으면 아무것도 하지 않음)
+// 해제(`on` = 0)하는 순간 모아둔 데이터가 전송됨
+void cork_socket(int fd, sockopt_t *opt, int on)
+{
+  if (opt->cork)
+    set_int_opt(fd, IPPROTO_TCP, TCP_CORK, on, "TCP_CORK");
+}
+
+// `server_sockopt`를 적용한 Server 연결 소켓을 만드는 함수 (open_clientfd와 같은 반환 값)
+// 버퍼 크기는 window scale에 반영되도록 connect 전에 적용
+int open_serverfd(char *hostname, char *port)
+{
+  int serverfd, rc;
+  struct addrinfo hints, *listp, *p;
+
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+  if ((rc = getaddrinfo(hostname, port, &hints, &listp)) != 0)
+  {
+    fprintf(stderr, "getaddrinfo failed (%s:%s): %s\n", hostname, port, gai_strerror(rc));
+    return -2;
+  }
+
+  for (p = listp; p; p = p->ai_next)
+  {
+    if ((serverfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+      continue;
+    set_sockopt(serverfd, &server_sockopt);
+#ifdef TCP_FASTOPEN_CONNECT
+    if (server_sockopt.fastopen) // 요청을 SYN과 함께 전송 (이전 연결에서 받은 cookie가 있는 경우)
+      set_int_opt(serverfd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT");
+#endif
+    if (connect(serverfd, p->ai_addr, p->ai_addrlen) != -1)
+      break;
+    close(serverfd);
+  }
+
+  freeaddrinfo(listp);
+  return p ? serverfd : -1;
+}
+
+// `opt`를 적용한 수신 소켓을 여는 함수 (open_listenfd와 같은 반환 값)
+// 버퍼 크기는 SYN-ACK의 window scale에 반영되도록 bind와 listen 사이에 적용
+int open_listenfd_sockopt(char *port, sockopt_t *opt)
+{
+  struct addrinfo hints, *listp, *p;
+  int listenfd, rc, optval = 1;
+
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG | AI_NUMERICSERV;
+  if ((rc = getaddrinfo(NULL, port, &hints, &listp)) != 0)
+  {
+    fprintf(stderr, "getaddrinfo failed (port %s): %s\n", port, gai_strerror(rc));
+    return -2;
+  }
+
+  for (p = listp; p; p = p->ai_next)
+  {
+    if ((listenfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0)
+      continue;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int));
+    if (bind(listenfd, p->ai_addr, p->ai_addrlen) == 0)
+      break;
+    close(listenfd);
+  }
+
+  freeaddrinfo(listp);
+  if (!p)
+    return -1;
+  set_listen_sockopt(listenfd, opt);
+  if (listen(listenfd, LISTENQ) < 0)
+  {
+    close(listenfd);
+    return -1;
+  }
+  return listenfd;
+}
+
+// 옵션 설정에 실패해도 연결은 계속 사용할 수 있으므로 경고만 출력
+static void set_int_opt(int fd, int level, int name, int value, char *label)
+{
+  if (setsockopt(fd, level, name, &value, sizeof(value)) < 0)
+    fprintf(stderr, "setsockopt %s failed: %s\n", label, strerror(errno));
+}
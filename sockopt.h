@@ -0,0 +1,23 @@
+#include <stdio.h>
+
+#include "csapp.h"
+
+// 소켓에 적용할 TCP 옵션 (0이면 적용하지 않음)
+typedef struct
+{
+  int nodelay;      // TCP_NODELAY: Nagle 알고리즘을 끄고 바로 전송
+  int cork;         // TCP_CORK: Header와 Body를 보내는 동안 전송을 모아서 가득 찬 세그먼트로 전송
+  int sndbuf;       // SO_SNDBUF 크기 (바이트)
+  int rcvbuf;       // SO_RCVBUF 크기 (바이트)
+  int defer_accept; // TCP_DEFER_ACCEPT 대기 시간(초): 요청 데이터가 도착한 연결만 accept (수신 소켓 전용)
+  int fastopen;     // TCP_FASTOPEN: 수신 소켓은 대기열 길이, Server 소켓은 1이면 사용
+} sockopt_t;
+
+extern sockopt_t client_sockopt; // Client 쪽 소켓(수신 소켓, accept한 소켓)의 옵션
+extern sockopt_t server_sockopt; // Server 쪽 소켓(Proxy가 연결하는 소켓)의 옵션
+
+int parse_sockopt(char *spec, sockopt_t *opt);
+void set_sockopt(int fd, sockopt_t *opt);
+void cork_socket(int fd, sockopt_t *opt, int on);
+int open_serverfd(char *hostname, char *port);
+int open_listenfd_sockopt(char *port, sockopt_t *opt);
@@ -3,38 +3,88 @@
  */
 /* $begin adder */
 #include "csapp.h"
+#include "handler.h"
+
+void add(FILE *out, const char *query, const char *method);
+int tiny_handler(const char *query, const char *method, char *buf, size_t size);
 
 int main(void)
 {
-    char *buf, *p;
+    char line[MAXLINE], method[MAXLINE], *query, *out;
+    size_t len;
+
+    if (!getenv("TINY_CGI_WORKER"))
+    { // 일반 CGI: 요청 하나를 처리하고 종료
+        add(stdout, getenv("QUERY_STRING"), getenv("REQUEST_METHOD"));
+        fflush(stdout); // 출력 버퍼 비움
+        exit(0);
+    }
+
+    /* Tiny의 persistent worker: `method query\n` 요청을 반복해서 받고 `TINY-CGI 길이\n` 뒤에 응답을 전송 */
+    while (fgets(line, MAXLINE, stdin))
+    {
+        line[strcspn(line, "\n")] = '\0';
+        query = strchr(line, ' ');
+        query = query ? query + 1 : "";
+        snprintf(method, MAXLINE, "%.*s", (int)strcspn(line, " "), line);
+
+        FILE *fp = open_memstream(&out, &len); // 응답 길이를 먼저 보내기 위해 메모리에 출력
+        add(fp, query, method);
+        fclose(fp);
+        printf("TINY-CGI %zu\n", len);
+        fwrite(out, 1, len, stdout);
+        fflush(stdout);
+        free(out);
+    }
+    exit(0);
+}
+
+// tiny의 플러그인 핸들러 (adder.so로 빌드했을 때 tiny가 dlopen해서 worker 스레드에서 호출)
+int tiny_handler(const char *query, const char *method, char *buf, size_t size)
+{
+    char *out;
+    size_t len;
+    FILE *fp = open_memstream(&out, &len);
+
+    add(fp, query, method);
+    fclose(fp);
+    if (len > size)
+    {
+        free(out);
+        return -1;
+    }
+    memcpy(buf, out, len);
+    free(out);
+    return len;
+}
+
+// query의 두 수를 더한 결과를 CGI 응답(헤더와 바디)으로 out에 출력
+void add(FILE *out, const char *query, const char *method)
+{
+    const char *buf, *p;
     char arg1[MAXLINE], arg2[MAXLINE], content[MAXLINE];
     int n1 = 0, n2 = 0;
 
-    if ((buf = getenv("QUERY_STRING")) != NULL)
+    if ((buf = query) != NULL && (p = strchr(buf, '&')) != NULL)
     {
-        p = strchr(buf, '&');
-        *p = '\0';
-        strcpy(arg1, buf);
+        snprintf(arg1, MAXLINE, "%.*s", (int)(p - buf), buf);
         strcpy(arg2, p + 1);
         n1 = atoi(arg1);
         n2 = atoi(arg2);
     }
 
-    sprintf(content, "QUERY_STRING=%s", buf); // HTML 형식으로 생성
-    sprintf(content, "Welcome to add.com: ");
-    sprintf(content, "%sTHE Internet addition portal.\r\n<p>", content);
-    sprintf(content, "%sThe answer is: %d + %d = %d\r\n<p>", content, n1, n2, n1 + n2);
-    sprintf(content, "%sThanks for visiting!\r\n", content);
-
-    printf("Connection: close\r\n");
-    printf("Content-length: %d\r\n", (int)strlen(content));
-    printf("Content-type: text/html\r\n\r\n");
+    // HTML 형식으로 생성
+    int n = 0;
+    n += sprintf(content + n, "Welcome to add.com: ");
+    n += sprintf(content + n, "THE Internet addition portal.\r\n<p>");
+    n += sprintf(content + n, "The answer is: %d + %d = %d\r\n<p>", n1, n2, n1 + n2);
+    n += sprintf(content + n, "Thanks for visiting!\r\n");
 
-    if (strcasecmp(getenv("REQUEST_METHOD"), "GET") == 0) // GET인 경우만
-        printf("%s", content);                            // HTML 응답의 바디인 content 출력
+    fprintf(out, "Connection: close\r\n");
+    fprintf(out, "Content-length: %d\r\n", n);
+    fprintf(out, "Content-type: text/html\r\n\r\n");
 
-    fflush(stdout); // 출력 버퍼 비움
-
-    exit(0);
+    if (method && strcasecmp(method, "GET") == 0) // GET인 경우만
+        fprintf(out, "%s", content);                      // HTML 응답의 바디인 content 출력
 }
 /* $end adder */
@@ -0,0 +1,78 @@
+#include "csapp.h"
+#include "diskio.h"
+
+static disk_job_t jobs[DISK_QUEUE_SIZE]; // 원형 대기열
+static int front, count;                 // 가장 먼저 들어온 작업의 위치, 대기 중인 작업 수
+static int disk_threads;                 // 디스크 스레드 수 (0이면 readahead 요청을 무시)
+static sem_t mutex;                      // 대기열을 보호하는 세마포어
+static sem_t items;                      // 대기 중인 작업 수
+
+static void *disk_thread(void *vargp);
+
+// 페이지 캐시로 파일을 미리 읽는 디스크 스레드 생성
+void init_diskio(int nthreads)
+{
+    pthread_t tid;
+
+    Sem_init(&mutex, 0, 1);
+    Sem_init(&items, 0, 0);
+    disk_threads = nthreads;
+    for (int i = 0; i < nthreads; i++)
+        Pthread_create(&tid, NULL, disk_thread, NULL);
+}
+
+// 파일(fd)의 offset부터 length바이트를 디스크 스레드가 페이지 캐시로 미리 읽도록 요청하는 함수
+// 요청한 스레드는 기다리지 않으며, 대기열이 가득 차면 요청을 버림 (sendfile이 직접 읽게 됨)
+// 요청 후에 파일 캐시가 fd를 닫아도 되도록 dup한 fd를 넘긴다.
+void disk_readahead(int fd, off_t offset, size_t length)
+{
+    int job_fd;
+
+    if (!disk_threads || length == 0)
+        return;
+    P(&mutex);
+    if (count == DISK_QUEUE_SIZE || (job_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0)
+    {
+        V(&mutex);
+        return;
+    }
+    disk_job_t *job = &jobs[(front + count++) % DISK_QUEUE_SIZE];
+    job->fd = job_fd;
+    job->offset = offset;
+    job->length = length;
+    V(&mutex);
+    V(&items);
+}
+
+// 대기열의 작업을 꺼내 페이지 캐시에 읽어두는 스레드
+// 디스크를 기다리는 동안 막히는 것은 이 스레드뿐이고, 요청을 처리하는 스레드는 그 사이 앞부분을 전송한다.
+static void *disk_thread(void *vargp)
+{
+    disk_job_t job;
+    char *buf = Malloc(DISK_READ_SIZE); // 읽은 내용은 버림 (페이지 캐시에 올리는 것이 목적이므로 스레드당 작은 버퍼만 사용)
+    ssize_t n;
+
+    Pthread_detach(pthread_self());
+    while (1)
+    {
+        P(&items);
+        P(&mutex);
+        job = jobs[front];
+        front = (front + 1) % DISK_QUEUE_SIZE;
+        count--;
+        V(&mutex);
+
+        // 구간 전체의 비동기 readahead를 요청한 뒤, 앞에서부터 읽으면서 디스크 I/O가 끝날 때까지 기다림
+        posix_fadvise(job.fd, job.offset, job.length, POSIX_FADV_WILLNEED);
+        for (size_t done = 0; done < job.length; done += n)
+        {
+            n = pread(job.fd, buf, job.length - done < DISK_READ_SIZE ? job.length - done : DISK_READ_SIZE, job.offset + done);
+            if (n < 0 && errno == EINTR) // 시그널로 중단된 경우만 다시 읽음 (n == 0이면 errno가 이전 값일 수 있음)
+                n = 0;
+            else if (n <= 0)
+                break;
+        }
+        Close(job.fd);
+    }
+    return NULL;
+}
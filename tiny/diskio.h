@@ -0,0 +1,22 @@
+#ifndef __DISKIO_H__
+#define __DISKIO_H__
+
+#include "csapp.h"
+
+#define DISK_QUEUE_SIZE 64   // 디스크 스레드가 처리를 기다리는 readahead 작업 최대 개수 (가득 차면 버림)
+#define DISK_CHUNK 1048576   // 큰 파일을 나눠서 전송하고 미리 읽는 단위
+#define DISK_THREADS 2       // 기본 디스크 스레드 수
+#define DISK_READ_SIZE 65536 // 디스크 스레드가 한 번에 읽는 크기
+
+// 디스크 스레드가 페이지 캐시로 미리 읽어둘 파일 구간
+typedef struct
+{
+    int fd; // 요청한 fd를 dup한 fd (작업을 마치면 디스크 스레드가 닫음)
+    off_t offset;
+    size_t length;
+} disk_job_t;
+
+void init_diskio(int nthreads);
+void disk_readahead(int fd, off_t offset, size_t length);
+
+#endif /* __DISKIO_H__ */
@@ -0,0 +1,19 @@
+#ifndef __HANDLER_H__
+#define __HANDLER_H__
+
+#include <stddef.h>
+
+/*
+ * tiny 동적 핸들러 플러그인 ABI
+ *   cgi-bin/프로그램 옆에 `프로그램.so`가 있으면 tiny가 처음 요청될 때 한 번 dlopen하고,
+ *   이후 요청은 fork/exec 없이 worker 스레드에서 HANDLER_SYMBOL 함수를 바로 호출한다.
+ *   핸들러는 CGI 프로그램의 표준 출력과 같은 형식(헤더, 빈 줄, 바디)으로 buf에 응답을 쓰고
+ *   쓴 길이를 리턴한다. -1을 리턴하면(버퍼 부족 등) tiny는 CGI 프로그램을 실행해서 처리한다.
+ *   여러 스레드에서 동시에 호출되므로 전역 상태나 환경 변수에 의존하면 안 된다.
+ */
+#define HANDLER_SYMBOL "tiny_handler"
+#define HANDLER_BUFSIZE 65536 // 핸들러에 넘기는 응답 버퍼 크기
+
+typedef int (*cgi_handler_t)(const char *query, const char *method, char *buf, size_t size);
+
+#endif /* __HANDLER_H__ */